@@ -11,6 +11,8 @@
 
 #include "HD44780.h"
 
+#include <string.h>
+
 /*
  * Constants
  */
@@ -18,9 +20,21 @@
 /** Address of the first position of the second line. */
 static const uint8_t HD44780_SECOND_LINE_ADDRESS = 0x40;
 
+/** Number of DDRAM positions in each line when the controller is configured for two lines operation. */
+static const uint8_t HD44780_LINE_LENGTH = 40;
+
 /** Number of spaces that should be printed when a tab character is printed to the lcd. */
 static const uint8_t HD44780_TAB_SIZE = 4;
 
+/** Character code of the full block in the A00 and A02 character ROMs. */
+static const uint8_t HD44780_FULL_BLOCK = 0xFF;
+
+/** Number of pixel columns of a character cell, the fill levels of a horizontal bar cell. */
+static const uint8_t HD44780_BAR_H_LEVELS = 5;
+
+/** Number of pixel rows of a 5x8 character cell, the fill levels of a vertical bar cell. */
+static const uint8_t HD44780_BAR_V_LEVELS = 8;
+
 /*
  * Commands
  */
@@ -63,478 +77,4024 @@ static const uint8_t HD44780_CMD_SET_DDRAM_ADDRESS = 0x80;
 
 static const uint8_t HD44780_CMD_READ_BUSYFLAG_AND_ADDRESS = 0X07;
 
+#if defined(HAL_I2C_MODULE_ENABLED)
+
 /*
- * Delay functionality
+ * PCF8574 backpack
  */
 
-/** Number of CPU cycles taken by one delay loop. */
-static const uint8_t DELAY_LOOP_CYCLES = 9;
+static const uint8_t HD44780_PCF8574_RS = 0x01;
+static const uint8_t HD44780_PCF8574_EN = 0x04;
+static const uint8_t HD44780_PCF8574_BACKLIGHT = 0x08;
+
+/** Number of I2C clock cycles taken by each expander output value: 8 data bits and the acknowledge. */
+static const uint32_t HD44780_PCF8574_FRAME_CLOCKS = 9;
 
-/** [ns] Amount of time taken by one delay loop. */
-static uint32_t delay_loop_time = 0;
+/** [Hz] I2C clock frequency assumed when HD44780_PCF8574::clock_hz is not set, the standard mode. */
+static const uint32_t HD44780_PCF8574_DEFAULT_CLOCK = 100000;
+
+#endif
+
+/*
+ * Timing
+ * See https://www.sparkfun.com/datasheets/LCD/HD44780.pdf pages 24-25 and 49.
+ */
+
+/** [ns] Address set-up time (RS, R/W to E) = 60ns */
+static const uint32_t HD44780_T_ADDRESS_SETUP = 60;
 
 /**
- * Initialize the delay functionality by calculating the delay loop time in nanoseconds based on the current clock.
- * Cannot define the delay loop time statically since SystemCoreClock is set after HAL initialization.
+ * [ns] Duration of the EN pulse when writing.
+ * Data set-up time = 195ns
+ * Enable rise/fall time = 25ns
+ * Total = 220ns
  */
-static void delay_init()
+static const uint32_t HD44780_T_ENABLE_WRITE = 240;
+
+/**
+ * [ns] Time between the rising edge of EN and the data lines sampling when reading.
+ * Data delay time = 360ns
+ * Enable rise/fall time = 25ns
+ * Total = 385ns
+ */
+static const uint32_t HD44780_T_ENABLE_READ = 400;
+
+/** [ns] Minimum time between two rising edges of EN. */
+static const uint32_t HD44780_T_ENABLE_CYCLE = 1000;
+
+/** [ns] Execution time of the clear display and return home instructions, with fosc = 270kHz. */
+static const uint32_t HD44780_T_EXEC_LONG = 1520000;
+
+/** [ns] Execution time of all the other instructions and of data writes, with fosc = 270kHz. */
+static const uint32_t HD44780_T_EXEC = 37000;
+
+/** [ns] Wait after VCC rises to 2.7V before the first instruction, more than 40ms. */
+static const uint32_t HD44780_T_POWER_ON = 50000000;
+
+/** [ns] Wait after the first function set of the initialization by instruction, more than 4.1ms. */
+static const uint32_t HD44780_T_RESET = 4500000;
+
+/*
+ * Delay functionality
+ */
+
+/** Timings waited with a tick count precomputed by delay_init(). */
+typedef enum
+{
+    DELAY_ADDRESS_SETUP,
+    DELAY_ENABLE_WRITE,
+    DELAY_ENABLE_READ,
+    DELAY_ENABLE_LOW_WRITE,
+    DELAY_ENABLE_LOW_READ,
+    DELAY_TIMINGS
+} DelayTiming;
+
+/**
+ * [ns] Get the duration of a precomputed timing.
+ */
+static inline uint32_t delay_timing_ns(DelayTiming timing)
 {
-    if (!delay_loop_time)
+    switch (timing)
     {
-        delay_loop_time = ((uint64_t)1000000000 * DELAY_LOOP_CYCLES) / SystemCoreClock;
+    case DELAY_ADDRESS_SETUP:
+        return HD44780_T_ADDRESS_SETUP;
+    case DELAY_ENABLE_WRITE:
+        return HD44780_T_ENABLE_WRITE;
+    case DELAY_ENABLE_READ:
+        return HD44780_T_ENABLE_READ;
+    case DELAY_ENABLE_LOW_WRITE:
+        return HD44780_T_ENABLE_CYCLE - HD44780_T_ENABLE_WRITE;
+    default:
+        return HD44780_T_ENABLE_CYCLE - HD44780_T_ENABLE_READ;
     }
 }
 
-// Disable optimization for the delay functions to get a more deterministic execution time.
-#pragma GCC push_options
-#pragma GCC optimize("O0")
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
 
 /**
- * Halt the program execution for the desired number of nanoseconds.
- * This function doesn't take into account the setup overhead (~330nS @ 72MHz).
- * For small delays you might run into a small amount of quantization error (~125nS @ 72MHz).
+ * Start the DWT cycle counter, the time base of the delays and of the operations left executing on a bus.
  */
-static inline __attribute__((always_inline)) void delay_ns(uint32_t ns)
+static inline void cycle_counter_start()
 {
-    volatile uint32_t counter = ns / delay_loop_time;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
 
-    while (counter--)
-        ;
+#if (__CORTEX_M == 7)
+    DWT->LAR = 0xC5ACCE55; // Unlock the DWT registers.
+#endif
+
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
-#pragma GCC pop_options
+#endif
+
+#ifdef HD44780_DELAY_NS
+
+// A platform specific delay implementation has been provided, e.g. by the host simulator.
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+#define delay_init() cycle_counter_start()
+#else
+#define delay_init()
+#endif
+#define delay_ns(ns) HD44780_DELAY_NS(ns)
+#define delay_timing(timing) HD44780_DELAY_NS(delay_timing_ns(timing))
+
+#else
 
 /**
- * Halt the program execution for the desired number of microseconds.
+ * [ticks / ns] Rate of the delay time base, as a 0.32 fixed point number so that converting a delay to ticks only
+ * takes a multiplication.
  */
-#define delay_us(us) delay_ns(us * 1000)
+static uint32_t delay_tick_rate = 0;
+
+/** [ticks] Tick counts of the precomputed timings. */
+static uint32_t delay_timing_ticks[DELAY_TIMINGS];
 
 /**
- * Halt the program execution for the desired number of milliseconds.
+ * Convert a delay to time base ticks, rounding up so that the delay is never shorter than requested.
  */
-#define delay_ms(ms) delay_ns(ms * 1000000)
+static inline uint32_t delay_ticks_of(uint32_t ns)
+{
+    return ((uint64_t)ns * delay_tick_rate + UINT32_MAX) >> 32;
+}
 
-/*
- * Internal function declarations
- */
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+
+// Cortex-M3 and above: the time base is the DWT cycle counter, running at the core clock.
 
 /**
- * Initialize the GPIO peripheral to the desired mode of operation.
+ * Start the cycle counter and compute the tick counts from the current clock.
+ * Cannot be done statically since SystemCoreClock is set after HAL initialization.
  */
-static inline void GPIO_init(GPIO_TypeDef *gpio, uint16_t pin, uint32_t mode);
+static void delay_init()
+{
+    cycle_counter_start();
+
+    delay_tick_rate = ((uint64_t)SystemCoreClock << 32) / 1000000000;
+
+    for (DelayTiming i = 0; i < DELAY_TIMINGS; ++i)
+    {
+        delay_timing_ticks[i] = delay_ticks_of(delay_timing_ns(i));
+    }
+}
 
 /**
- * Set the GPIO mode of the pins connected to the controller data lines.
+ * Halt the program execution for the desired number of cycle counter ticks.
  */
-static void HD44780_set_data_mode(const HD44780 *lcd, uint32_t mode);
+static inline __attribute__((always_inline)) void delay_ticks(uint32_t ticks)
+{
+    uint32_t start = DWT->CYCCNT;
+
+    while (DWT->CYCCNT - start < ticks)
+        ;
+}
+
+#else
+
+// Cortex-M0 and M0+ have no cycle counter: the time base is SysTick, started by HAL_Init() with a 1ms period.
 
 /**
- * Perform a read operation returning, depending on the chosen data length, the 4 or 8 bit value representing the state
- * of the mcu pins connected to the controller data lines.
+ * Start SysTick when not already running and compute the tick counts from the current clock.
+ * Cannot be done statically since SystemCoreClock is set after HAL initialization.
  */
-static uint8_t HD44780_pull_value(const HD44780 *lcd);
+static void delay_init()
+{
+    if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk))
+    {
+        SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+        SysTick->VAL = 0;
+        SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+    }
+
+    // Without the processor clock source SysTick runs from the external reference clock, HCLK / 8 on stm32.
+    uint32_t clock = SysTick->CTRL & SysTick_CTRL_CLKSOURCE_Msk ? SystemCoreClock : SystemCoreClock / 8;
+    delay_tick_rate = ((uint64_t)clock << 32) / 1000000000;
+
+    for (DelayTiming i = 0; i < DELAY_TIMINGS; ++i)
+    {
+        delay_timing_ticks[i] = delay_ticks_of(delay_timing_ns(i));
+    }
+}
 
 /**
- * Perform a write operation setting, depending on the chosen data length, a 4 bit or 8 bit value to the mcu pins
- * connected to the controller data lines.
+ * Halt the program execution for the desired number of SysTick ticks.
  */
-static void HD44780_push_value(const HD44780 *lcd, uint8_t byte);
+static inline __attribute__((always_inline)) void delay_ticks(uint32_t ticks)
+{
+    // SysTick counts down and wraps around to the reload value, the elapsed ticks are accumulated across reloads.
+    uint32_t period = SysTick->LOAD + 1;
+    uint32_t last = SysTick->VAL;
+    uint32_t elapsed = 0;
+
+    while (elapsed < ticks)
+    {
+        uint32_t now = SysTick->VAL;
+        elapsed += last >= now ? last - now : last + period - now;
+        last = now;
+    }
+}
+
+#endif
 
 /**
- * Read a byte from the lcd registers.
+ * Halt the program execution for the desired number of nanoseconds.
+ * Short delays are rounded up to the time base resolution, 1 cycle with the cycle counter.
  */
-static uint8_t HD44780_read_byte(const HD44780 *lcd);
+static inline __attribute__((always_inline)) void delay_ns(uint32_t ns)
+{
+    delay_ticks(delay_ticks_of(ns));
+}
 
 /**
- * Write a byte to the lcd registers.
+ * Halt the program execution for one of the precomputed timings.
  */
-static void HD44780_write_byte(const HD44780 *lcd, bool rs, uint8_t byte);
+#define delay_timing(timing) delay_ticks(delay_timing_ticks[timing])
+
+#endif
 
 /**
- * Write a byte to the lcd registers in initialization mode,
- * where the data length is always 8 bit and the last 4 bits are discarded.
+ * Halt the program execution for the desired number of microseconds.
  */
-static void HD44780_write_init(const HD44780 *lcd, uint8_t byte);
+#define delay_us(us) delay_ns(us * 1000)
 
 /**
- * Get the value of the address counter.
- * This address counter is used by both CG and DDRAM addresses,
- * and its value is determined by the previous instruction.
- * The address contents are the same as for instructions set CGRAM address and set DDRAM address.
+ * Halt the program execution for the desired number of milliseconds.
  */
-static inline uint8_t HD44780_get_address(const HD44780 *lcd);
+#define delay_ms(ms) delay_ns(ms * 1000000)
 
-/**
- * Read the busy flag (BF) indicating that the system is now internally operating on a previously received
- * instruction. If the return code is 1, the internal operation is in progress. The next instruction will not be
- * accepted until BF is reset to 0. Check the BF status before the next write operation.
+/*
+ * Register access
  */
-static inline uint8_t HD44780_get_busyflag(const HD44780 *lcd);
 
 /**
- * Loop until the busy flag goes low.
+ * Drive a single pin high through the port bit set/reset register.
  */
-static inline void HD44780_await_busyflag(const HD44780 *lcd);
+#define GPIO_set(gpio, pin) HD44780_GPIO_WRITE(gpio, BSRR, (uint32_t)(pin))
 
 /**
- * Write a byte to the lcd instruction register.
+ * Drive a single pin low through the port bit set/reset register.
+ */
+#define GPIO_reset(gpio, pin) HD44780_GPIO_WRITE(gpio, BSRR, (uint32_t)(pin) << 16)
+
+/*
+ * Critical sections
  */
-static inline void HD44780_write_instruction(const HD44780 *lcd, uint8_t byte);
 
 /**
- * Write a byte to the lcd data register.
+ * Mask the interrupts, returning the previous mask to be restored by critical_exit().
  */
-static inline void HD44780_write_data(const HD44780 *lcd, uint8_t byte);
+static inline uint32_t critical_enter(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
 
 /**
- * Get the line on which the cursor is currently positioned.
+ * Restore the interrupt mask saved by critical_enter(), so that the critical sections can be nested.
  */
-static inline uint8_t HD44780_get_current_line(const HD44780 *lcd);
+static inline void critical_exit(uint32_t primask)
+{
+    __set_PRIMASK(primask);
+}
 
 /*
- * Public function definitions
+ * Statistics
  */
 
-void HD44780_init(const HD44780 *lcd)
-{
-    delay_init();
-
-    GPIO_init(lcd->rs_gpio, lcd->rs_pin, GPIO_MODE_OUTPUT_PP);
-    GPIO_init(lcd->rw_gpio, lcd->rw_pin, GPIO_MODE_OUTPUT_PP);
-    GPIO_init(lcd->en_gpio, lcd->en_pin, GPIO_MODE_OUTPUT_PP);
-    HD44780_set_data_mode(lcd, GPIO_MODE_OUTPUT_PP);
+#if defined(HD44780_STATS)
 
-    HAL_GPIO_WritePin(lcd->rs_gpio, lcd->rs_pin, GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(lcd->rw_gpio, lcd->rw_pin, GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_RESET);
+/**
+ * Add to a counter of HD44780::stats.
+ */
+#define HD44780_STAT(lcd, counter, n) ((lcd)->stats.counter += (n))
 
-    // Initialization by instruction.
-    // See https://www.sparkfun.com/datasheets/LCD/HD44780.pdf pages 45-46.
+#else
 
-    delay_ms(50); // Wait for more than 40 ms after VCC rises to 2.7V.
-    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
-    delay_us(4500); // Wait for more than 4.1ms.
-    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
-    delay_us(120); // Wait for more than 100us.
-    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
-    delay_us(50); // BF cannot be checked before this instruction, wait more than 37us.
+// The arguments are still evaluated, so that the values only used by the counters do not trigger warnings.
+#define HD44780_STAT(lcd, counter, n) ((void)(lcd), (void)(n))
 
-    if (!lcd->interface_8_bit)
-    {
-        HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_4BIT);
-        delay_us(50); // BF cannot be checked before this instruction, wait more than 37us.
-    }
+#endif
 
-    uint8_t flg_data_len = lcd->interface_8_bit ? HD44780_FLG_DATA_LEN_8BIT : HD44780_FLG_DATA_LEN_4BIT;
-    uint8_t flg_line_qty = lcd->single_line ? HD44780_FLG_1_LINE : HD44780_FLG_2_LINE;
-    uint8_t flg_font_size = lcd->font_5x10 ? HD44780_FLG_FONT_5X10 : HD44780_FLG_FONT_5X8;
+/*
+ * Internal types
+ */
 
-    HD44780_write_instruction(lcd, HD44780_CMD_FUNCTION_SET | flg_data_len | flg_line_qty | flg_font_size);
-    HD44780_write_instruction(lcd, HD44780_CMD_DISPLAY_CONTROL);
-    HD44780_write_instruction(lcd, HD44780_CMD_CLEAR_DISPLAY);
-    HD44780_write_instruction(lcd, HD44780_CMD_ENTRY_MODE_SET | HD44780_FLG_DISPLAY_NOSHIFT | HD44780_FLG_DIR_LTR);
-    HD44780_write_instruction(lcd, HD44780_CMD_DISPLAY_CONTROL | HD44780_FLG_DISPLAY_ON | HD44780_FLG_CURSOR_OFF |
-                                       HD44780_FLG_BLINK_OFF);
-}
+/**
+ * Destination of the instructions (rs = false) and data bytes (rs = true) generated by HD44780_fb_sync().
+ */
+typedef void (*HD44780_Sink)(HD44780 *lcd, void *context, bool rs, uint8_t byte);
 
-void HD44780_configure(const HD44780 *lcd, const HD44780_Config *config)
+/**
+ * Position in the sequence of operations bringing the DDRAM in sync with the framebuffer, see HD44780_fb_next().
+ */
+typedef struct
 {
-    uint8_t flg_display_en = config->disable_display ? HD44780_FLG_DISPLAY_OFF : HD44780_FLG_DISPLAY_ON;
-    uint8_t flg_cursor_en = config->enable_cursor ? HD44780_FLG_CURSOR_ON : HD44780_FLG_CURSOR_OFF;
-    uint8_t flg_blink_en = config->enable_blink ? HD44780_FLG_BLINK_ON : HD44780_FLG_BLINK_OFF;
-    uint8_t flg_shift_entity = config->shift_display ? HD44780_FLG_DISPLAY_SHIFT : HD44780_FLG_DISPLAY_NOSHIFT;
-    uint8_t flg_shift_dir = config->shift_rtl ? HD44780_FLG_DIR_RTL : HD44780_FLG_DIR_LTR;
-
-    HD44780_write_instruction(lcd, HD44780_CMD_ENTRY_MODE_SET | flg_shift_entity | flg_shift_dir);
-    HD44780_write_instruction(lcd, HD44780_CMD_DISPLAY_CONTROL | flg_display_en | flg_cursor_en | flg_blink_en);
-}
+    uint8_t index;           /**< Next framebuffer cell to be examined or sent. */
+    uint8_t run_end;         /**< End of the run of cells being sent. */
+    bool entry_mode_changed; /**< Whether the entry mode was changed for the flush and must be restored. */
+    bool moved;              /**< Whether the address counter was moved and must be restored to the cursor. */
+} HD44780_FbIterator;
 
-void HD44780_clear(const HD44780 *lcd)
+/**
+ * Groups of operations with the same execution time, used as indexes of HD44780_State::exec_estimate.
+ */
+typedef enum
 {
-    HD44780_write_instruction(lcd, HD44780_CMD_CLEAR_DISPLAY);
-}
+    HD44780_EXEC_DATA,  /**< Data write to DDRAM or CGRAM. */
+    HD44780_EXEC_SHORT, /**< Any instruction except clear display and return home. */
+    HD44780_EXEC_LONG,  /**< Clear display and return home instructions. */
+} HD44780_ExecClass;
 
-void HD44780_return_home(const HD44780 *lcd)
+/**
+ * Steps of the initialization started by HD44780_init_start(), stored in HD44780_State::init_step.
+ */
+typedef enum
 {
-    HD44780_write_instruction(lcd, HD44780_CMD_RETURN_HOME);
-}
+    HD44780_INIT_DONE,     /**< Initialization completed, or blocking initialization with HD44780_init(). */
+    HD44780_INIT_POWER_ON, /**< Waiting for the supply to settle before the first function set. */
+    HD44780_INIT_RESET,    /**< Waiting after the first function set, before the remaining ones. */
+} HD44780_InitStep;
 
-void HD44780_cursor_to(const HD44780 *lcd, uint8_t column, uint8_t row)
+/**
+ * Buffer of GPIO BSRR register values output at a fixed rate to drive the controller lines.
+ */
+typedef struct
 {
-    // When the display is configured for single line operation, the address range is 0x00 to 0x4F.
-    // For two line operation the address range is 0x00 to 0x27 for the first line,
-    // and 0x40 to 0x67 for the second line.
-    uint8_t start = row % 2 && !lcd->single_line ? HD44780_SECOND_LINE_ADDRESS : 0;
-    uint8_t addr = start + column;
-    HD44780_write_instruction(lcd, HD44780_CMD_SET_DDRAM_ADDRESS | addr);
-}
+    uint32_t *words;  /**< Output buffer. */
+    size_t capacity;  /**< Size of the output buffer in words. */
+    size_t count;     /**< Number of words generated, can exceed the capacity. */
+    uint32_t tick_ns; /**< [ns] Time between two consecutive words. */
+} HD44780_Waveform;
 
-void HD44780_shift_display(const HD44780 *lcd, int8_t n)
+/**
+ * Copy of the controller state tracked by HD44780_track_address(), taken before generating writes that may be
+ * discarded.
+ */
+typedef struct
 {
-    uint8_t flg_shift_dir = n < 0 ? HD44780_FLG_SHIFT_RTL : HD44780_FLG_SHIFT_LTR;
+    uint8_t address;
+    bool address_cgram;
+    bool address_increment;
+    bool shift_on_write;
+    uint8_t display_shift;
+} HD44780_Tracked;
 
-    for (uint8_t i = 0; i < abs(n); ++i)
-    {
-        HD44780_write_instruction(lcd, HD44780_CMD_CURSOR_DISPLAY_SHIFT | HD44780_FLG_SHIFT_DISPLAY | flg_shift_dir);
-    }
-}
+/** Size of the buffer of a formatted number: sign, digits of an unsigned long (10 for 32 bits) and decimal point. */
+#define HD44780_NUMBER_SIZE (sizeof(unsigned long) * 5 / 2 + 2)
 
-void HD44780_create_symbol(const HD44780 *lcd, uint8_t address, bool font_5x10, const uint8_t symbol[])
+/**
+ * Characters produced by HD44780_vprintf() or HD44780_flush(), written to the lcd in runs to use the fast data paths.
+ */
+typedef struct
 {
-    uint8_t ddram_address = HD44780_get_address(lcd);
+    HD44780 *lcd;    /**< Destination instance. */
+    uint8_t buf[16]; /**< Characters waiting to be written. */
+    uint8_t len;     /**< Number of characters waiting to be written. */
+} HD44780_Writer;
 
-    HD44780_write_instruction(lcd, HD44780_CMD_SET_CGRAM_ADDRESS | (address << 3));
+/*
+ * Internal function declarations
+ */
 
-    uint8_t height = font_5x10 ? 10 : 8;
+/**
+ * Initialize the GPIO peripheral to the desired mode of operation.
+ */
+static inline void GPIO_init(GPIO_TypeDef *gpio, uint16_t pin, uint32_t mode);
 
-    for (uint8_t i = 0; i < height; ++i)
-    {
-        HD44780_write_data(lcd, symbol[i]);
-    }
+/**
+ * Group the data lines by GPIO port and precompute the port register values for every nibble.
+ */
+static void HD44780_init_data_ports(HD44780 *lcd);
 
-    // Fill remaining pixels with whitespace.
-    if (font_5x10)
-    {
-        for (uint8_t i = 0; i < 6; ++i)
-        {
-            HD44780_write_data(lcd, 0);
-        }
-    }
+/**
+ * Initialize the GPIO peripheral for the pins connected to the controller data lines.
+ */
+static void HD44780_init_data_pins(HD44780 *lcd, uint32_t mode);
 
-    HD44780_write_instruction(lcd, HD44780_CMD_SET_DDRAM_ADDRESS | ddram_address);
-}
+/**
+ * Reset the library state of an instance and configure its pins, before the initialization sequence.
+ */
+static void HD44780_init_instance(HD44780 *lcd);
 
-void HD44780_put_char(const HD44780 *lcd, uint8_t chr)
-{
-    switch (chr)
-    {
-    case '\n': {
-        uint8_t line = HD44780_get_current_line(lcd);
+/**
+ * Send the initialization by instruction following the wait after the first function set, leaving the controller in
+ * the configured interface mode.
+ */
+static void HD44780_init_interface(HD44780 *lcd);
 
-        if (!lcd->single_line && !line)
-        {
-            HD44780_cursor_to(lcd, 0, 1);
-        }
-        else
-        {
-            HD44780_cursor_to(lcd, 0, 0);
-        }
+/**
+ * Configure the controller once in the desired interface mode, then clear the display.
+ */
+static void HD44780_init_configuration(HD44780 *lcd);
 
-        break;
-    }
+/**
+ * [ns] Get the part of a wait started at a HAL_GetTick() value that may not have elapsed yet.
+ */
+static uint32_t HD44780_tick_remaining(uint32_t since, uint32_t ns);
 
-    case '\t': {
-        for (uint8_t i = 0; i < HD44780_TAB_SIZE; ++i)
-        {
-            HD44780_write_data(lcd, ' ');
-        }
+/**
+ * Perform the steps of the initialization started by HD44780_init_start() whose wait has elapsed, without blocking.
+ */
+static void HD44780_init_advance(HD44780 *lcd);
 
-        break;
-    }
+/**
+ * Mark the initialization as completed. Without the asynchronous mode, the operations buffered in the meantime are sent
+ * at once.
+ */
+static void HD44780_init_complete(HD44780 *lcd);
 
-    default: {
-        HD44780_write_data(lcd, chr);
-    }
-    }
-}
+/**
+ * Switch the direction of the pins connected to the controller data lines, when not already in the desired direction.
+ */
+static inline void HD44780_set_data_mode(HD44780 *lcd, bool input);
 
-void HD44780_put_str(const HD44780 *lcd, const char *str)
-{
-    for (size_t i = 0; str[i] != '\0'; ++i)
-    {
-        HD44780_put_char(lcd, str[i]);
-    }
-}
+/**
+ * Perform a read operation returning, depending on the chosen data length, the 4 or 8 bit value representing the state
+ * of the mcu pins connected to the controller data lines.
+ */
+static uint8_t HD44780_pull_value(HD44780 *lcd);
 
-/*
- * Internal function definitions
+/**
+ * Perform a write operation setting, depending on the chosen data length, a 4 bit or 8 bit value to the mcu pins
+ * connected to the controller data lines.
  */
+static void HD44780_push_value(HD44780 *lcd, uint8_t byte);
 
-static inline void GPIO_init(GPIO_TypeDef *gpio, uint16_t pin, uint32_t mode)
-{
-    GPIO_InitTypeDef GPIO_InitStruct = {.Pull = GPIO_NOPULL, .Speed = GPIO_SPEED_FREQ_HIGH, .Pin = pin, .Mode = mode};
-    HAL_GPIO_Init(gpio, &GPIO_InitStruct);
-}
+/**
+ * Drive the data lines with a value, through the lookup tables when available.
+ */
+static void HD44780_drive_data(HD44780 *lcd, uint8_t byte);
 
-static void HD44780_set_data_mode(const HD44780 *lcd, uint32_t mode)
-{
-    GPIO_init(lcd->d7_gpio, lcd->d7_pin, mode);
-    GPIO_init(lcd->d6_gpio, lcd->d6_pin, mode);
-    GPIO_init(lcd->d5_gpio, lcd->d5_pin, mode);
-    GPIO_init(lcd->d4_gpio, lcd->d4_pin, mode);
+/**
+ * Read a byte from the lcd registers, the busy flag and address counter when rs is 0, DDRAM or CGRAM otherwise.
+ */
+static uint8_t HD44780_read_byte(HD44780 *lcd, bool rs);
 
-    if (lcd->interface_8_bit)
-    {
-        GPIO_init(lcd->d3_gpio, lcd->d3_pin, mode);
-        GPIO_init(lcd->d2_gpio, lcd->d2_pin, mode);
-        GPIO_init(lcd->d1_gpio, lcd->d1_pin, mode);
+/**
+ * Get the direction of the data lines, shared by all the instances on the same bus.
+ */
+static inline bool *HD44780_data_input(HD44780 *lcd);
+
+/**
+ * Get the flag reserving the bus, shared by all the instances on the same bus.
+ */
+static inline volatile bool *HD44780_bus_lock(HD44780 *lcd);
+
+/**
+ * Drive the EN line, or the EN lines of all the instances on the bus during a broadcast.
+ */
+static inline void HD44780_set_enable(HD44780 *lcd, bool high);
+
+/**
+ * Check whether the controller completed the operation left executing, without waiting.
+ */
+static bool HD44780_is_idle(HD44780 *lcd);
+
+/**
+ * Wait until the controller completes the operation left executing.
+ */
+static inline void HD44780_await_pending(HD44780 *lcd);
+
+/**
+ * Wait until the queued operations and the operation left executing are completed.
+ */
+static void HD44780_drain(HD44780 *lcd);
+
+/**
+ * Send an instruction to all the instances on a bus at once.
+ */
+static void HD44780_broadcast_instruction(HD44780_Bus *bus, uint8_t byte);
+
+/**
+ * Get the entry mode set and display control instructions corresponding to a configuration.
+ */
+static void HD44780_config_instructions(const HD44780_Config *config, uint8_t *entry_mode, uint8_t *display_control);
+
+/**
+ * Drive the data lines and set the RS and RW lines to write to the desired register.
+ */
+static void HD44780_select_register(HD44780 *lcd, bool rs);
+
+/**
+ * Send a byte on the data lines, in one or two transfers depending on the interface width.
+ */
+static inline void HD44780_push_byte(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Start writing a byte to the lcd registers, without waiting for the controller to execute it.
+ */
+static void HD44780_transmit_byte(HD44780 *lcd, bool rs, uint8_t byte);
+
+/**
+ * Write a run of characters without special character handling, wrapping it at the end of the visible rows.
+ */
+static void HD44780_write_run(HD44780 *lcd, const uint8_t *data, size_t len);
+
+/**
+ * Write a run of characters to consecutive addresses.
+ */
+static void HD44780_write_span(HD44780 *lcd, const uint8_t *data, size_t len);
+
+/**
+ * Send a run of data bytes to the controller, bypassing the framebuffer.
+ */
+static void HD44780_send_data(HD44780 *lcd, const uint8_t *data, size_t len);
+
+/**
+ * Get the cycle count used for the timings of HD44780::stats, 0 when HD44780_STATS is not defined.
+ */
+static inline uint32_t HD44780_stats_clock(void);
+
+/**
+ * Call the HD44780::trace hook at the start of a bus transaction.
+ *
+ * @return The cycle count at the start of the transaction, to be passed to HD44780_transaction_end().
+ */
+static inline uint32_t HD44780_transaction_begin(HD44780 *lcd);
+
+/**
+ * Account for the duration of a bus transaction, then call the HD44780::trace hook.
+ */
+static inline void HD44780_transaction_end(HD44780 *lcd, uint32_t start);
+
+/**
+ * Check whether the operations are queued, in asynchronous mode and until the initialization started by
+ * HD44780_init_start() completes.
+ */
+static inline bool HD44780_is_queued(HD44780 *lcd);
+
+/**
+ * Write a byte to the lcd registers, or queue it when the asynchronous mode is enabled or the initialization is in
+ * progress.
+ */
+static void HD44780_write_byte(HD44780 *lcd, bool rs, uint8_t byte);
+
+/**
+ * Wait until all the queued operations have been executed, then reserve the bus for a synchronous operation.
+ * Only needed in asynchronous mode and for instances on a shared bus.
+ */
+static void HD44780_lock_bus(HD44780 *lcd);
+
+/**
+ * Release the bus reserved by HD44780_lock_bus().
+ */
+static inline void HD44780_unlock_bus(HD44780 *lcd);
+
+/**
+ * Write a byte to the lcd registers in initialization mode,
+ * where the data length is always 8 bit and the last 4 bits are discarded.
+ */
+static void HD44780_write_init(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Update the shadow of the address counter with the effect of an instruction or data write sent to the controller.
+ */
+static void HD44780_track_address(HD44780 *lcd, bool rs, uint8_t byte);
+
+/**
+ * Move the shadow of the address counter by one position, wrapping around the same way the controller does.
+ */
+static inline void HD44780_step_address(HD44780 *lcd, bool increment);
+
+/**
+ * Copy the tracked controller state, see HD44780_Tracked.
+ */
+static inline HD44780_Tracked HD44780_save_tracked(HD44780 *lcd);
+
+/**
+ * Restore the tracked controller state copied by HD44780_save_tracked(), undoing the effect of the writes generated
+ * since then.
+ */
+static inline void HD44780_restore_tracked(HD44780 *lcd, const HD44780_Tracked *tracked);
+
+/**
+ * Read the busy flag (BF) indicating that the system is now internally operating on a previously received
+ * instruction. If the return code is 1, the internal operation is in progress. The next instruction will not be
+ * accepted until BF is reset to 0. Check the BF status before the next write operation.
+ */
+static inline uint8_t HD44780_get_busyflag(HD44780 *lcd);
+
+/**
+ * Loop until the busy flag goes low. The part of the learned execution time of the operation not yet elapsed is waited
+ * before the first poll, then the estimate is updated with the measured time.
+ *
+ * @param elapsed [ns] Time elapsed since the operation was sent, 0 when it was just sent.
+ *
+ * @param exact Whether @p elapsed is exact, otherwise it is a lower bound and an early completion does not shorten the
+ * estimate.
+ */
+static inline void HD44780_await_busyflag(HD44780 *lcd, HD44780_ExecClass exec_class, uint32_t elapsed, bool exact);
+
+/**
+ * Mark the operation just sent as left executing, to be waited before the next access to the controller.
+ */
+static inline void HD44780_set_pending(HD44780 *lcd, bool rs, uint8_t byte);
+
+/**
+ * [ns] Get the time elapsed since the operation left executing was sent. It is measured with the cycle counter when the
+ * core has one, otherwise only the whole milliseconds counted by HAL_GetTick() are known.
+ *
+ * @param exact Set to whether the result is exact rather than a lower bound.
+ */
+static inline uint32_t HD44780_pending_elapsed(HD44780 *lcd, bool *exact);
+
+/**
+ * Wait for the controller to execute an instruction or data write, either by polling the busy flag or, in write only
+ * mode, by waiting for its execution time.
+ */
+static inline void HD44780_await_execution(HD44780 *lcd, bool rs, uint8_t byte);
+
+/**
+ * Get the set DDRAM or CGRAM address instruction moving the address counter to its tracked position.
+ */
+static inline uint8_t HD44780_address_instruction(HD44780 *lcd);
+
+/**
+ * Write an instruction and wait for its execution in place, bypassing the queue. The bus must be reserved.
+ */
+static void HD44780_send_instruction(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Reserve the bus for reading the controller RAM, once the operation left executing is completed.
+ *
+ * @return The instruction restoring the address counter, to be passed to HD44780_release_ram().
+ */
+static uint8_t HD44780_acquire_ram(HD44780 *lcd);
+
+/**
+ * Restore the address counter moved by the RAM reads, then release the bus.
+ */
+static void HD44780_release_ram(HD44780 *lcd, uint8_t restore);
+
+/**
+ * Read a run of consecutive DDRAM or CGRAM addresses, in address order whatever the entry mode direction.
+ * The bus must be reserved with HD44780_acquire_ram().
+ */
+static void HD44780_read_run(HD44780 *lcd, bool cgram, uint8_t address, uint8_t *data, size_t len);
+
+/**
+ * Write a byte to the lcd instruction register.
+ */
+static inline void HD44780_write_instruction(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Write a byte to the lcd data register.
+ */
+static inline void HD44780_write_data(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Compute the DDRAM address of the first visible column of each row.
+ */
+static void HD44780_init_geometry(HD44780 *lcd);
+
+/**
+ * Get the number of visible columns of a row, the DDRAM line length when the geometry is not set.
+ */
+static inline uint8_t HD44780_row_width(HD44780 *lcd);
+
+/**
+ * Get the DDRAM address of the cursor, the framebuffer cursor when the framebuffer is enabled.
+ */
+static inline uint8_t HD44780_cursor_address(HD44780 *lcd);
+
+/**
+ * Find the visible position of a DDRAM address.
+ *
+ * @return false when the address is not displayed, or the address counter points to CGRAM.
+ */
+static bool HD44780_locate(HD44780 *lcd, uint8_t address, uint8_t *column, uint8_t *row);
+
+/**
+ * Get the row on which the cursor is currently positioned. Outside of the visible area, the first row on the same
+ * DDRAM line as the cursor.
+ */
+static uint8_t HD44780_get_current_row(HD44780 *lcd);
+
+/**
+ * Write a printable character to the framebuffer when enabled, otherwise directly to the lcd data register.
+ */
+static void HD44780_write_character(HD44780 *lcd, uint8_t chr);
+
+/**
+ * Convert a DDRAM address to the corresponding framebuffer index.
+ * In two lines mode the second line (0x40 to 0x67) is stored right after the first line (0x00 to 0x27).
+ */
+static inline uint8_t HD44780_fb_index(HD44780 *lcd, uint8_t address);
+
+/**
+ * Convert a framebuffer index to the corresponding DDRAM address.
+ */
+static inline uint8_t HD44780_fb_address(HD44780 *lcd, uint8_t index);
+
+/**
+ * Check whether the framebuffer cell at the given index differs from the content of the controller DDRAM.
+ */
+static inline bool HD44780_fb_is_dirty(HD44780 *lcd, uint8_t index);
+
+/**
+ * Get the next operation of the minimum sequence of instructions and data writes bringing the DDRAM in sync with the
+ * framebuffer. The dirty cells are not cleared.
+ *
+ * @return false when the sequence is complete.
+ */
+static bool HD44780_fb_next(HD44780 *lcd, HD44780_FbIterator *it, bool *rs, uint8_t *byte);
+
+/**
+ * Send the whole sequence generated by HD44780_fb_next() to a sink.
+ */
+static void HD44780_fb_sync(HD44780 *lcd, HD44780_Sink sink, void *context);
+
+/**
+ * Sink collecting the generated data bytes in a @ref HD44780_Writer, so that each run is sent with
+ * HD44780_send_data(). The instructions are written to the controller after the data bytes preceding them.
+ */
+static void HD44780_run_sink(HD44780 *lcd, void *context, bool rs, uint8_t byte);
+
+/**
+ * Write consecutive CGRAM rows, starting at an address taken modulo the CGRAM size, and update their shadow. The
+ * address counter is moved back to its position afterwards.
+ */
+static void HD44780_write_cgram(HD44780 *lcd, uint8_t address, const uint8_t *rows, uint8_t len);
+
+/**
+ * Hash the 8 bytes of a CGRAM symbol slot.
+ */
+static inline uint16_t HD44780_slot_hash(const uint8_t *rows);
+
+/**
+ * Get the bitmap of the CGRAM symbol slots displayed in the visible area of the framebuffer, 0 without framebuffer.
+ */
+static uint8_t HD44780_visible_glyphs(HD44780 *lcd);
+
+/**
+ * Format an integer backwards from the end of a buffer of at least @ref HD44780_NUMBER_SIZE characters.
+ *
+ * @param decimals Number of digits after the decimal point, at most 9.
+ *
+ * @return The first character of the formatted number.
+ */
+static char *HD44780_format_number(char *end,
+                                   unsigned long value,
+                                   bool negative,
+                                   uint8_t base,
+                                   bool upper,
+                                   uint8_t decimals);
+
+/**
+ * Append a character to the output of HD44780_vprintf().
+ */
+static void HD44780_writer_put(HD44780_Writer *writer, char chr);
+
+/**
+ * Append count copies of a character to the output of HD44780_vprintf().
+ */
+static void HD44780_writer_fill(HD44780_Writer *writer, char chr, int count);
+
+/**
+ * Write the characters waiting in the output of HD44780_vprintf() to the lcd.
+ */
+static void HD44780_writer_flush(HD44780_Writer *writer);
+
+/**
+ * Build the symbol of a partially filled bar cell.
+ */
+static void HD44780_bar_symbol(bool vertical, uint8_t fill, uint8_t symbol[10]);
+
+/**
+ * Get the character code displayed by a bar cell at the desired fill level.
+ */
+static uint8_t HD44780_bar_cell(HD44780 *lcd, const HD44780_Bar *bar, uint8_t cell, uint16_t level);
+
+/**
+ * Get the number of positions after which the display shift wraps around, the length of a DDRAM line.
+ */
+static inline uint8_t HD44780_shift_length(HD44780 *lcd);
+
+/**
+ * Move the shadow of the display shift by one position, to the left or to the right.
+ */
+static inline void HD44780_step_shift(HD44780 *lcd, bool left);
+
+/**
+ * Get the number of DDRAM columns of a page: the visible columns of the rows sharing a DDRAM line.
+ */
+static inline uint8_t HD44780_page_width(HD44780 *lcd);
+
+/**
+ * Get the DDRAM address of a column of the line of a row, counted from the first visible column of the row on the
+ * first page and wrapping around the end of the DDRAM line.
+ */
+static inline uint8_t HD44780_line_address(HD44780 *lcd, uint8_t row, uint8_t column);
+
+/**
+ * Move the cursor to a DDRAM address, the instruction is skipped when the address counter already points to it.
+ */
+static void HD44780_address_to(HD44780 *lcd, uint8_t address);
+
+/**
+ * Write the characters of a ticker up to the desired index to the DDRAM line of its row.
+ */
+static void HD44780_ticker_load(HD44780 *lcd, HD44780_Ticker *ticker, uint32_t end);
+
+/**
+ * Get the DDRAM address of the desired position.
+ */
+static inline uint8_t HD44780_ddram_address(HD44780 *lcd, uint8_t column, uint8_t row);
+
+/**
+ * Get the execution time group of an instruction or data write.
+ */
+static inline HD44780_ExecClass HD44780_exec_class(bool rs, uint8_t byte);
+
+/**
+ * Get the datasheet execution time of an execution time group.
+ */
+static inline uint32_t HD44780_nominal_execution_time(HD44780_ExecClass exec_class);
+
+/**
+ * Get the time needed by the controller to execute an instruction or data write, including the safety margin.
+ */
+static inline uint32_t HD44780_execution_time(bool rs, uint8_t byte);
+
+/**
+ * Check whether the wiring allows generating waveforms, which requires GPIO pins with RS, EN and the data lines on
+ * the same port.
+ */
+static inline bool HD44780_wave_supported(HD44780 *lcd);
+
+/**
+ * Append a word to the waveform, followed by the desired number of idle (zero) words.
+ */
+static inline void HD44780_wave_push(HD44780_Waveform *wave, uint32_t word, uint32_t idle);
+
+/**
+ * Get the number of waveform ticks covering the desired duration.
+ */
+static inline uint32_t HD44780_wave_ticks(const HD44780_Waveform *wave, uint32_t ns);
+
+/**
+ * Append the waveform transferring a 4 or 8 bit value to the controller.
+ */
+static void HD44780_wave_value(HD44780 *lcd, HD44780_Waveform *wave, bool rs, uint8_t value);
+
+/**
+ * Sink appending the waveform of the generated bytes, followed by their execution time.
+ */
+static void HD44780_wave_sink(HD44780 *lcd, void *context, bool rs, uint8_t byte);
+
+#if defined(HAL_I2C_MODULE_ENABLED)
+
+/**
+ * Drive the expander outputs low, except for the backlight. See HD44780_Transport::init.
+ */
+static void HD44780_pcf8574_init(HD44780 *lcd);
+
+/**
+ * Send the expander output values of a run of bytes, spaced by their execution time, in as few I2C transactions as
+ * the frame buffer allows. See HD44780_Transport::write.
+ */
+static void HD44780_pcf8574_write(HD44780 *lcd, bool rs, const uint8_t *data, size_t len);
+
+/**
+ * Send the expander output values of a single transfer on DB7 to DB4. See HD44780_Transport::write_init.
+ */
+static void HD44780_pcf8574_write_init(HD44780 *lcd, uint8_t byte);
+
+/**
+ * Append an expander output value to the frames, transmitting them when the buffer is full.
+ */
+static void HD44780_pcf8574_push(HD44780_PCF8574 *pcf, uint8_t frame);
+
+/**
+ * Append the expander output values transferring a nibble: EN high with the data lines driven, then EN low.
+ */
+static inline void HD44780_pcf8574_nibble(HD44780_PCF8574 *pcf, uint8_t frame);
+
+/**
+ * Transmit the frames waiting in the buffer, in a single I2C transaction.
+ */
+static void HD44780_pcf8574_transmit(HD44780_PCF8574 *pcf);
+
+/**
+ * Wait for the end of the DMA transfer of the frames, so that the buffer can be filled again.
+ */
+static inline void HD44780_pcf8574_await(HD44780_PCF8574 *pcf);
+
+#endif
+
+/*
+ * Public function definitions
+ */
+
+void HD44780_init(HD44780 *lcd)
+{
+    HD44780_init_instance(lcd);
+
+    // Initialization by instruction.
+    // See https://www.sparkfun.com/datasheets/LCD/HD44780.pdf pages 45-46.
+
+    // The power-on wait has usually elapsed already when the mcu was powered along with the lcd.
+    delay_ns(HD44780_tick_remaining(lcd->power_on_tick, HD44780_T_POWER_ON));
+    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
+    delay_ns(HD44780_T_RESET);
+    HD44780_init_interface(lcd);
+    HD44780_init_configuration(lcd);
+}
+
+void HD44780_init_start(HD44780 *lcd)
+{
+    HD44780_init_instance(lcd);
+
+    lcd->state.init_step = HD44780_INIT_POWER_ON;
+    lcd->state.init_tick = lcd->power_on_tick;
+
+    // The configuration is queued ahead of the operations requested during the initialization.
+    HD44780_init_configuration(lcd);
+    HD44780_poll(lcd);
+}
+
+bool HD44780_init_step(HD44780 *lcd)
+{
+    HD44780_poll(lcd);
+
+    return lcd->state.init_step == HD44780_INIT_DONE;
+}
+
+void HD44780_configure(HD44780 *lcd, const HD44780_Config *config)
+{
+    uint8_t display_control;
+    HD44780_config_instructions(config, &lcd->state.entry_mode, &display_control);
+
+    HD44780_write_instruction(lcd, lcd->state.entry_mode);
+    HD44780_write_instruction(lcd, display_control);
+}
+
+void HD44780_clear(HD44780 *lcd)
+{
+    lcd->state.page_offset = 0;
+
+    if (lcd->framebuffer)
+    {
+        lcd->state.fb_cursor = 0;
+
+        for (uint8_t i = 0; i < HD44780_DDRAM_SIZE; ++i)
+        {
+            HD44780_write_character(lcd, ' ');
+        }
+
+        // The clear display instruction is not sent, the display shift is restored like the instruction would.
+        HD44780_shift_to(lcd, 0);
+        return;
+    }
+
+    HD44780_write_instruction(lcd, HD44780_CMD_CLEAR_DISPLAY);
+}
+
+void HD44780_return_home(HD44780 *lcd)
+{
+    lcd->state.page_offset = 0;
+    HD44780_write_instruction(lcd, HD44780_CMD_RETURN_HOME);
+    lcd->state.fb_cursor = 0;
+}
+
+void HD44780_cursor_to(HD44780 *lcd, uint8_t column, uint8_t row)
+{
+    uint8_t addr = HD44780_ddram_address(lcd, column, row);
+
+    if (lcd->framebuffer)
+    {
+        lcd->state.fb_cursor = HD44780_fb_index(lcd, addr);
+        return;
+    }
+
+    HD44780_write_instruction(lcd, HD44780_CMD_SET_DDRAM_ADDRESS | addr);
+}
+
+void HD44780_shift_display(HD44780 *lcd, int8_t n)
+{
+    uint8_t flg_shift_dir = n < 0 ? HD44780_FLG_SHIFT_RTL : HD44780_FLG_SHIFT_LTR;
+
+    for (uint8_t i = 0; i < abs(n); ++i)
+    {
+        HD44780_write_instruction(lcd, HD44780_CMD_CURSOR_DISPLAY_SHIFT | HD44780_FLG_SHIFT_DISPLAY | flg_shift_dir);
+    }
+}
+
+void HD44780_shift_to(HD44780 *lcd, uint8_t offset)
+{
+    uint8_t length = HD44780_shift_length(lcd);
+    uint8_t left = (offset % length + length - lcd->state.display_shift) % length;
+
+    // Past half of the line, shifting to the right takes fewer instructions.
+    HD44780_shift_display(lcd, left <= length / 2 ? left : left - length);
+}
+
+uint8_t HD44780_page_count(HD44780 *lcd)
+{
+    uint8_t count = HD44780_shift_length(lcd) / HD44780_page_width(lcd);
+    return count ? count : 1;
+}
+
+void HD44780_page_draw(HD44780 *lcd, uint8_t page)
+{
+    lcd->state.page_offset = page % HD44780_page_count(lcd) * HD44780_page_width(lcd);
+}
+
+void HD44780_page_show(HD44780 *lcd, uint8_t page)
+{
+    HD44780_shift_to(lcd, page % HD44780_page_count(lcd) * HD44780_page_width(lcd));
+}
+
+void HD44780_ticker_start(HD44780 *lcd, HD44780_Ticker *ticker)
+{
+    ticker->length = strlen(ticker->text);
+    ticker->position = 0;
+    ticker->loaded = 0;
+
+    HD44780_shift_to(lcd, 0);
+    HD44780_ticker_load(lcd, ticker, HD44780_shift_length(lcd));
+}
+
+void HD44780_ticker_step(HD44780 *lcd, HD44780_Ticker *ticker)
+{
+    uint8_t length = HD44780_shift_length(lcd);
+
+    // The column about to be shown is loaded together with all the columns that scrolled out of view.
+    if (ticker->loaded < ticker->position + HD44780_row_width(lcd) + 1)
+    {
+        HD44780_ticker_load(lcd, ticker, ticker->position + length);
+    }
+
+    HD44780_shift_display(lcd, 1);
+    ticker->position++;
+
+    // Keep the indexes bounded, a whole period maps every index to the same column and character.
+    uint32_t period = (uint32_t)length * ticker->length;
+
+    if (ticker->position >= period)
+    {
+        ticker->position -= period;
+        ticker->loaded -= period;
+    }
+}
+
+void HD44780_create_symbol(HD44780 *lcd, uint8_t address, bool font_5x10, const uint8_t symbol[])
+{
+    // 5x10 symbols take two slots, fill remaining pixels with whitespace.
+    uint8_t content[16] = {0};
+    uint8_t size = font_5x10 ? 16 : 8;
+    memcpy(content, symbol, font_5x10 ? 10 : 8);
+
+    uint8_t base = address << 3;
+    uint8_t first = size;
+    uint8_t last = 0;
+
+    // Only the range of rows that differ from the known CGRAM content is sent.
+    for (uint8_t i = 0; i < size; ++i)
+    {
+        uint8_t index = (base + i) % HD44780_CGRAM_SIZE;
+        bool known = lcd->state.cgram_valid & (1 << (index / 8));
+
+        if (!known || lcd->state.cgram[index] != content[i])
+        {
+            first = first < size ? first : i;
+            last = i;
+        }
+    }
+
+    if (first == size)
+    {
+        return;
+    }
+
+    HD44780_write_cgram(lcd, base + first, &content[first], last - first + 1);
+
+    for (uint8_t i = 0; i < size; i += 8)
+    {
+        uint8_t slot = ((base + i) % HD44780_CGRAM_SIZE) / 8;
+        lcd->state.cgram_valid |= 1 << slot;
+        lcd->state.cgram_hash[slot] = HD44780_slot_hash(&lcd->state.cgram[slot * 8]);
+    }
+}
+
+uint8_t HD44780_glyph(HD44780 *lcd, const uint8_t symbol[])
+{
+    uint8_t content[16] = {0};
+    uint8_t step = lcd->font_5x10 ? 2 : 1;
+    memcpy(content, symbol, lcd->font_5x10 ? 10 : 8);
+
+    uint16_t hash[2] = {HD44780_slot_hash(&content[0]), HD44780_slot_hash(&content[8])};
+    uint16_t clock = ++lcd->state.glyph_clock;
+
+    for (uint8_t slot = 0; slot < 8; slot += step)
+    {
+        bool found = true;
+
+        for (uint8_t i = 0; i < step; ++i)
+        {
+            found &= (lcd->state.cgram_valid & (1 << (slot + i))) && lcd->state.cgram_hash[slot + i] == hash[i] &&
+                     !memcmp(&lcd->state.cgram[(slot + i) * 8], &content[i * 8], 8);
+        }
+
+        if (found)
+        {
+            lcd->state.glyph_used[slot] = clock;
+            return slot;
+        }
+    }
+
+    // Replace the least recently requested slot, preferring the hidden slots and then the ones with unknown content.
+    uint8_t visible = HD44780_visible_glyphs(lcd);
+    uint8_t victim = 0;
+    uint32_t victim_score = 0;
+
+    for (uint8_t slot = 0; slot < 8; slot += step)
+    {
+        uint8_t mask = ((1 << step) - 1) << slot;
+        uint32_t score = (uint16_t)(clock - lcd->state.glyph_used[slot]);
+
+        score += (visible & mask) ? 0 : 0x20000;
+        score += (lcd->state.cgram_valid & mask) == mask ? 0 : 0x10000;
+
+        if (!slot || score > victim_score)
+        {
+            victim = slot;
+            victim_score = score;
+        }
+    }
+
+    HD44780_create_symbol(lcd, victim, lcd->font_5x10, symbol);
+    lcd->state.glyph_used[victim] = clock;
+
+    return victim;
+}
+
+void HD44780_bar_init(HD44780 *lcd, HD44780_Bar *bar)
+{
+    uint8_t levels = bar->vertical ? HD44780_BAR_V_LEVELS : HD44780_BAR_H_LEVELS;
+
+    // Vertical bars grow upwards from their row, the cells above row 0 would wrap around to the other rows.
+    if (bar->vertical && bar->length > bar->row + 1)
+    {
+        bar->length = bar->row + 1;
+    }
+
+    for (uint8_t fill = 1; fill < levels; ++fill)
+    {
+        uint8_t symbol[10];
+        HD44780_bar_symbol(bar->vertical, fill, symbol);
+        HD44780_glyph(lcd, symbol);
+    }
+
+    // Draw all the cells as if the bar was full before.
+    bar->level = bar->length * levels;
+    HD44780_bar_set(lcd, bar, 0);
+}
+
+void HD44780_bar_set(HD44780 *lcd, HD44780_Bar *bar, uint16_t level)
+{
+    uint8_t levels = bar->vertical ? HD44780_BAR_V_LEVELS : HD44780_BAR_H_LEVELS;
+    uint16_t max = bar->length * levels;
+
+    level = level < max ? level : max;
+
+    if (level == bar->level)
+    {
+        return;
+    }
+
+    // Only the cells between the old and the new boundary change.
+    uint16_t low = level < bar->level ? level : bar->level;
+    uint16_t high = level < bar->level ? bar->level : level;
+    uint8_t first = low / levels;
+    uint8_t last = (high - 1) / levels;
+
+    for (uint8_t cell = first; cell <= last; ++cell)
+    {
+        uint8_t chr = HD44780_bar_cell(lcd, bar, cell, level);
+
+        // Horizontal cells are adjacent, the cursor is already in place after the first one.
+        if (bar->vertical)
+        {
+            HD44780_cursor_to(lcd, bar->column, bar->row - cell);
+        }
+        else if (cell == first)
+        {
+            HD44780_cursor_to(lcd, bar->column + cell, bar->row);
+        }
+
+        HD44780_write_buf(lcd, &chr, 1);
+    }
+
+    bar->level = level;
+}
+
+void HD44780_put_char(HD44780 *lcd, uint8_t chr)
+{
+    switch (chr)
+    {
+    case '\n': {
+        uint8_t row = HD44780_get_current_row(lcd);
+        HD44780_cursor_to(lcd, 0, (row + 1) % lcd->state.row_count);
+        break;
+    }
+
+    case '\t': {
+        // One run of HD44780_TAB_SIZE spaces.
+        HD44780_write_run(lcd, (const uint8_t *)"    ", HD44780_TAB_SIZE);
+        break;
+    }
+
+    default: {
+        HD44780_write_run(lcd, &chr, 1);
+    }
+    }
+}
+
+void HD44780_put_str(HD44780 *lcd, const char *str)
+{
+    HD44780_write_buf(lcd, (const uint8_t *)str, strlen(str));
+}
+
+void HD44780_write_buf(HD44780 *lcd, const uint8_t *data, size_t len)
+{
+    size_t start = 0;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (data[i] != '\n' && data[i] != '\t')
+        {
+            continue;
+        }
+
+        HD44780_write_run(lcd, &data[start], i - start);
+        HD44780_put_char(lcd, data[i]);
+        start = i + 1;
+    }
+
+    HD44780_write_run(lcd, &data[start], len - start);
+}
+
+void HD44780_write_buf_at(HD44780 *lcd, uint8_t column, uint8_t row, const uint8_t *data, size_t len)
+{
+    HD44780_cursor_to(lcd, column, row);
+    HD44780_write_buf(lcd, data, len);
+}
+
+void HD44780_printf(HD44780 *lcd, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    HD44780_vprintf(lcd, format, args);
+    va_end(args);
+}
+
+void HD44780_printf_at(HD44780 *lcd, uint8_t column, uint8_t row, const char *format, ...)
+{
+    HD44780_cursor_to(lcd, column, row);
+
+    va_list args;
+    va_start(args, format);
+    HD44780_vprintf(lcd, format, args);
+    va_end(args);
+}
+
+void HD44780_vprintf(HD44780 *lcd, const char *format, va_list args)
+{
+    HD44780_Writer writer = {.lcd = lcd};
+
+    for (const char *p = format; *p; ++p)
+    {
+        if (*p != '%')
+        {
+            HD44780_writer_put(&writer, *p);
+            continue;
+        }
+
+        bool left = false;
+        bool zero_pad = false;
+        int width = 0;
+        int precision = -1;
+
+        for (++p; *p == '-' || *p == '0'; ++p)
+        {
+            left |= *p == '-';
+            zero_pad |= *p == '0';
+        }
+
+        if (*p == '*')
+        {
+            width = va_arg(args, int);
+            left |= width < 0;
+            width = abs(width);
+            ++p;
+        }
+
+        for (; *p >= '0' && *p <= '9'; ++p)
+        {
+            width = width * 10 + *p - '0';
+        }
+
+        if (*p == '.')
+        {
+            precision = 0;
+
+            if (*++p == '*')
+            {
+                precision = va_arg(args, int);
+                ++p;
+            }
+
+            for (; *p >= '0' && *p <= '9'; ++p)
+            {
+                precision = precision * 10 + *p - '0';
+            }
+        }
+
+        // A short argument is promoted to int, a long one is read as such. Wider integers and wide characters are not
+        // supported, their specification is handled as malformed.
+        bool is_long = *p == 'l';
+        p += is_long;
+
+        while (*p == 'h' && !is_long)
+        {
+            ++p;
+        }
+
+        if (is_long && (*p == 'c' || *p == 's'))
+        {
+            HD44780_writer_flush(&writer);
+            return;
+        }
+
+        char number[HD44780_NUMBER_SIZE];
+        char *end = number + sizeof(number);
+        const char *str = end;
+        uint8_t decimals = precision < 0 ? 0 : precision < 9 ? precision : 9;
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i': {
+            long value = is_long ? va_arg(args, long) : va_arg(args, int);
+            unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+            str = HD44780_format_number(end, magnitude, value < 0, 10, false, decimals);
+            break;
+        }
+
+        case 'u':
+        case 'x':
+        case 'X': {
+            unsigned long value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+            bool decimal = *p == 'u';
+            str = HD44780_format_number(end, value, false, decimal ? 10 : 16, *p == 'X', decimal ? decimals : 0);
+            break;
+        }
+
+        case 'c':
+            *--end = (char)va_arg(args, int);
+            str = end;
+            end++;
+            break;
+
+        case 's':
+            str = va_arg(args, const char *);
+            end = (char *)str;
+
+            while (*end && (precision < 0 || end - str < precision))
+            {
+                end++;
+            }
+
+            zero_pad = false;
+            break;
+
+        case '%':
+            HD44780_writer_put(&writer, '%');
+            continue;
+
+        default:
+            // Unsupported conversion, stop at the malformed specification.
+            HD44780_writer_flush(&writer);
+            return;
+        }
+
+        int pad = width - (int)(end - str);
+
+        if (!left && zero_pad && *str == '-')
+        {
+            HD44780_writer_put(&writer, *str++);
+        }
+
+        if (!left)
+        {
+            HD44780_writer_fill(&writer, zero_pad ? '0' : ' ', pad);
+        }
+
+        while (str < end)
+        {
+            HD44780_writer_put(&writer, *str++);
+        }
+
+        if (left)
+        {
+            HD44780_writer_fill(&writer, ' ', pad);
+        }
+    }
+
+    HD44780_writer_flush(&writer);
+}
+
+void HD44780_field_set(HD44780 *lcd, HD44780_Field *field, int32_t value)
+{
+    uint8_t width = field->width < HD44780_FIELD_WIDTH ? field->width : HD44780_FIELD_WIDTH;
+    uint8_t decimals = field->decimals < 9 ? field->decimals : 9;
+
+    char number[HD44780_NUMBER_SIZE];
+    char *end = number + sizeof(number);
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    char *str = HD44780_format_number(end, magnitude, value < 0, 10, false, decimals);
+    uint8_t len = end - str;
+
+    char text[HD44780_FIELD_WIDTH];
+
+    if (len > width)
+    {
+        memset(text, '#', width);
+    }
+    else
+    {
+        // Right aligned, zero padding goes after the sign.
+        uint8_t pad = width - len;
+        uint8_t sign = field->zero_pad && *str == '-';
+
+        text[0] = '-';
+        memset(&text[sign], field->zero_pad ? '0' : ' ', pad);
+        memcpy(&text[sign + pad], str + sign, len - sign);
+    }
+
+    // Runs of changed characters separated by a single unchanged one are merged, rewriting it costs as much as moving
+    // the cursor past it.
+    for (uint8_t i = 0; i < width; ++i)
+    {
+        if (text[i] == field->text[i])
+        {
+            continue;
+        }
+
+        uint8_t last = i;
+
+        for (uint8_t j = i + 1; j < width && j <= last + 2; ++j)
+        {
+            if (text[j] != field->text[j])
+            {
+                last = j;
+            }
+        }
+
+        HD44780_write_buf_at(lcd, field->column + i, field->row, (const uint8_t *)&text[i], last - i + 1);
+        i = last;
+    }
+
+    memcpy(field->text, text, width);
+}
+
+void HD44780_flush(HD44780 *lcd)
+{
+    // Until the initialization completes the changed characters are only marked, see HD44780_init_complete().
+    if (!lcd->framebuffer || (!lcd->async && lcd->state.init_step != HD44780_INIT_DONE))
+    {
+        return;
+    }
+
+    HD44780_Writer run = {.lcd = lcd};
+
+    HD44780_fb_sync(lcd, HD44780_run_sink, &run);
+    HD44780_send_data(lcd, run.buf, run.len);
+    memset(lcd->state.fb_dirty, 0, sizeof(lcd->state.fb_dirty));
+}
+
+void HD44780_poll(HD44780 *lcd)
+{
+    volatile bool *locked = HD44780_bus_lock(lcd);
+
+    // An interrupt cannot be preempted by the main program, so a plain flag is enough to avoid interleaving.
+    if (*locked)
+    {
+        return;
+    }
+
+    // The queued operations wait for the initialization started by HD44780_init_start().
+    if (lcd->state.init_step != HD44780_INIT_DONE)
+    {
+        *locked = true;
+        HD44780_init_advance(lcd);
+        *locked = false;
+
+        if (lcd->state.init_step != HD44780_INIT_DONE)
+        {
+            return;
+        }
+    }
+
+    // Nothing to execute, the bus is not accessed.
+    if (!lcd->state.exec_pending && lcd->state.queue_head == lcd->state.queue_tail)
+    {
+        return;
+    }
+
+    *locked = true;
+    uint32_t start = HD44780_transaction_begin(lcd);
+
+    if (lcd->state.exec_pending)
+    {
+        if (HD44780_get_busyflag(lcd))
+        {
+            HD44780_transaction_end(lcd, start);
+            *locked = false;
+            return;
+        }
+
+        lcd->state.exec_pending = false;
+
+        if (lcd->state.queue_head == lcd->state.queue_tail && lcd->on_idle)
+        {
+            lcd->on_idle(lcd);
+        }
+    }
+
+    if (lcd->state.queue_head != lcd->state.queue_tail)
+    {
+        uint16_t entry = lcd->state.queue[lcd->state.queue_tail];
+
+        HD44780_transmit_byte(lcd, entry >> 8, entry);
+
+        lcd->state.queue_tail = (lcd->state.queue_tail + 1) % HD44780_QUEUE_SIZE;
+
+        // Without the busy flag there is nothing to poll, the execution time is waited here.
+        if (lcd->write_only)
+        {
+            HD44780_await_execution(lcd, entry >> 8, entry);
+
+            if (lcd->state.queue_head == lcd->state.queue_tail && lcd->on_idle)
+            {
+                lcd->on_idle(lcd);
+            }
+        }
+        else
+        {
+            HD44780_set_pending(lcd, entry >> 8, entry);
+        }
+    }
+
+    HD44780_transaction_end(lcd, start);
+    *locked = false;
+}
+
+uint8_t HD44780_queue_depth(HD44780 *lcd)
+{
+    uint8_t queued = (lcd->state.queue_head + HD44780_QUEUE_SIZE - lcd->state.queue_tail) % HD44780_QUEUE_SIZE;
+    return queued + lcd->state.exec_pending;
+}
+
+void HD44780_channel_write(HD44780_Channel *channel, uint8_t column, uint8_t row, const uint8_t *data, size_t len)
+{
+    HD44780 *lcd = channel->lcd;
+    uint8_t width = HD44780_row_width(lcd);
+    size_t first = (size_t)(row % lcd->state.row_count) * width + column;
+
+    if (column >= width || first >= HD44780_DDRAM_SIZE)
+    {
+        return;
+    }
+
+    len = len < (size_t)(width - column) ? len : (size_t)(width - column);
+    len = len < HD44780_DDRAM_SIZE - first ? len : HD44780_DDRAM_SIZE - first;
+
+    uint32_t primask = critical_enter();
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        size_t index = first + i;
+        channel->cells[index] = data[i];
+        channel->dirty[index / 8] |= 1 << (index % 8);
+    }
+
+    channel->sequence++;
+
+    critical_exit(primask);
+
+    if (channel->notify)
+    {
+        channel->notify(channel);
+    }
+}
+
+void HD44780_channel_put_str(HD44780_Channel *channel, uint8_t column, uint8_t row, const char *str)
+{
+    HD44780_channel_write(channel, column, row, (const uint8_t *)str, strlen(str));
+}
+
+void HD44780_channel_glyph(HD44780_Channel *channel, uint8_t address, const uint8_t symbol[])
+{
+    uint8_t slot = address % 8;
+    uint32_t primask = critical_enter();
+
+    memcpy(&channel->glyphs[slot * 8], symbol, 8);
+    channel->glyphs_dirty |= 1 << slot;
+    channel->sequence++;
+
+    critical_exit(primask);
+
+    if (channel->notify)
+    {
+        channel->notify(channel);
+    }
+}
+
+bool HD44780_channel_render(HD44780_Channel *channel)
+{
+    HD44780 *lcd = channel->lcd;
+    uint8_t width = HD44780_row_width(lcd);
+    uint8_t cells[HD44780_DDRAM_SIZE];
+    uint8_t dirty[HD44780_DDRAM_SIZE / 8];
+    uint8_t glyphs[HD44780_CGRAM_SIZE];
+    uint8_t glyphs_dirty;
+
+    // Take the pending updates at once, the producers can post new ones while they are written. The copy is made with
+    // the interrupts enabled, and made again when an update was posted meanwhile: the producers store their updates
+    // with the interrupts masked, so an unchanged sequence number means that no update was copied in part.
+    for (;;)
+    {
+        uint32_t primask = critical_enter();
+        uint32_t sequence = channel->sequence;
+        critical_exit(primask);
+
+        glyphs_dirty = channel->glyphs_dirty;
+        memcpy(cells, channel->cells, sizeof(cells));
+        memcpy(dirty, channel->dirty, sizeof(dirty));
+        memcpy(glyphs, channel->glyphs, sizeof(glyphs));
+
+        primask = critical_enter();
+
+        if (channel->sequence == sequence)
+        {
+            memset(channel->dirty, 0, sizeof(channel->dirty));
+            channel->glyphs_dirty = 0;
+            critical_exit(primask);
+            break;
+        }
+
+        critical_exit(primask);
+    }
+
+    bool pending = glyphs_dirty;
+
+    for (uint8_t slot = 0; slot < 8; ++slot)
+    {
+        if (glyphs_dirty & (1 << slot))
+        {
+            HD44780_create_symbol(lcd, slot, false, &glyphs[slot * 8]);
+        }
+    }
+
+    uint8_t index = 0;
+
+    while (index < HD44780_DDRAM_SIZE)
+    {
+        if (!(dirty[index / 8] & (1 << (index % 8))))
+        {
+            ++index;
+            continue;
+        }
+
+        // Extend the run along the row while the characters are pending, the positions are resolved on the page
+        // currently drawn.
+        uint8_t address = HD44780_ddram_address(lcd, index % width, index / width);
+        uint8_t end = index + 1;
+
+        while (end < HD44780_DDRAM_SIZE && end % width && (dirty[end / 8] & (1 << (end % 8))))
+        {
+            ++end;
+        }
+
+        HD44780_address_to(lcd, address);
+        HD44780_write_span(lcd, &cells[index], end - index);
+
+        pending = true;
+        index = end;
+    }
+
+    if (pending && lcd->framebuffer)
+    {
+        HD44780_flush(lcd);
+    }
+
+    return pending;
+}
+
+size_t HD44780_read_ddram(HD44780 *lcd, uint8_t address, uint8_t *data, size_t len)
+{
+    len = len < HD44780_DDRAM_SIZE ? len : HD44780_DDRAM_SIZE;
+
+    if (lcd->write_only || !len)
+    {
+        return 0;
+    }
+
+    uint8_t restore = HD44780_acquire_ram(lcd);
+    HD44780_read_run(lcd, false, address & 0x7F, data, len);
+    HD44780_release_ram(lcd, restore);
+
+    return len;
+}
+
+size_t HD44780_read_cgram(HD44780 *lcd, uint8_t address, uint8_t *data, size_t len)
+{
+    len = len < HD44780_CGRAM_SIZE ? len : HD44780_CGRAM_SIZE;
+
+    if (lcd->write_only || !len)
+    {
+        return 0;
+    }
+
+    uint8_t restore = HD44780_acquire_ram(lcd);
+    HD44780_read_run(lcd, true, address & 0x3F, data, len);
+    HD44780_release_ram(lcd, restore);
+
+    return len;
+}
+
+size_t HD44780_repair(HD44780 *lcd)
+{
+    if (lcd->write_only)
+    {
+        return 0;
+    }
+
+    uint8_t cgram[HD44780_CGRAM_SIZE];
+    uint8_t ddram[HD44780_DDRAM_SIZE];
+    uint8_t corrupted_slots = 0;
+    size_t corrupted = 0;
+
+    uint8_t restore = HD44780_acquire_ram(lcd);
+
+    // Runs of consecutive known slots are read with a single address instruction.
+    uint8_t slot = 0;
+
+    while (slot < 8)
+    {
+        if (!(lcd->state.cgram_valid & (1 << slot)))
+        {
+            ++slot;
+            continue;
+        }
+
+        uint8_t end = slot + 1;
+
+        while (end < 8 && (lcd->state.cgram_valid & (1 << end)))
+        {
+            ++end;
+        }
+
+        HD44780_read_run(lcd, true, slot * 8, &cgram[slot * 8], (end - slot) * 8);
+
+        for (uint8_t i = slot * 8; i < end * 8; ++i)
+        {
+            if ((cgram[i] ^ lcd->state.cgram[i]) & 0x1F)
+            {
+                corrupted_slots |= 1 << (i / 8);
+                ++corrupted;
+            }
+        }
+
+        slot = end;
+    }
+
+    if (lcd->framebuffer)
+    {
+        // One run per DDRAM line, the framebuffer indexes of a line have consecutive addresses.
+        uint8_t lines = lcd->single_line ? 1 : 2;
+        uint8_t length = HD44780_DDRAM_SIZE / lines;
+
+        for (uint8_t line = 0; line < lines; ++line)
+        {
+            HD44780_read_run(lcd, false, HD44780_fb_address(lcd, line * length), &ddram[line * length], length);
+        }
+
+        for (uint8_t index = 0; index < HD44780_DDRAM_SIZE; ++index)
+        {
+            if (!HD44780_fb_is_dirty(lcd, index) && ddram[index] != lcd->framebuffer[index])
+            {
+                lcd->state.fb_dirty[index / 8] |= 1 << (index % 8);
+                ++corrupted;
+            }
+        }
+    }
+
+    HD44780_release_ram(lcd, restore);
+
+    for (slot = 0; slot < 8; ++slot)
+    {
+        if (!(corrupted_slots & (1 << slot)))
+        {
+            continue;
+        }
+
+        // Only the range of the corrupted rows is sent again, from the shadow.
+        uint8_t first = 8;
+        uint8_t last = 0;
+
+        for (uint8_t i = 0; i < 8; ++i)
+        {
+            if ((cgram[slot * 8 + i] ^ lcd->state.cgram[slot * 8 + i]) & 0x1F)
+            {
+                first = first < 8 ? first : i;
+                last = i;
+            }
+        }
+
+        HD44780_write_cgram(lcd, slot * 8 + first, &lcd->state.cgram[slot * 8 + first], last - first + 1);
+    }
+
+    if (lcd->framebuffer)
+    {
+        HD44780_flush(lcd);
+    }
+
+    return corrupted;
+}
+
+void HD44780_bus_clear(HD44780_Bus *bus)
+{
+    HD44780_broadcast_instruction(bus, HD44780_CMD_CLEAR_DISPLAY);
+
+    // The clear display instruction filled the DDRAM with spaces, so the framebuffers are in sync once cleared. As in
+    // HD44780_clear(), the first page is shown and selected again.
+    for (uint8_t i = 0; i < bus->controller_count; ++i)
+    {
+        HD44780 *lcd = bus->controllers[i];
+        lcd->state.page_offset = 0;
+
+        if (lcd->framebuffer)
+        {
+            memset(lcd->framebuffer, ' ', HD44780_DDRAM_SIZE);
+            memset(lcd->state.fb_dirty, 0, sizeof(lcd->state.fb_dirty));
+            lcd->state.fb_cursor = 0;
+        }
+    }
+}
+
+void HD44780_bus_configure(HD44780_Bus *bus, const HD44780_Config *config)
+{
+    uint8_t entry_mode, display_control;
+    HD44780_config_instructions(config, &entry_mode, &display_control);
+
+    for (uint8_t i = 0; i < bus->controller_count; ++i)
+    {
+        bus->controllers[i]->state.entry_mode = entry_mode;
+    }
+
+    HD44780_broadcast_instruction(bus, entry_mode);
+    HD44780_broadcast_instruction(bus, display_control);
+}
+
+void HD44780_bus_flush(HD44780_Bus *bus)
+{
+    HD44780_FbIterator iterators[HD44780_MAX_BUS_CONTROLLERS] = {0};
+    bool active[HD44780_MAX_BUS_CONTROLLERS];
+    uint8_t remaining = 0;
+
+    for (uint8_t i = 0; i < bus->controller_count; ++i)
+    {
+        HD44780 *lcd = bus->controllers[i];
+
+        // As in HD44780_flush(), an initialization in progress keeps the changed characters marked until it completes.
+        active[i] = lcd->framebuffer && (lcd->async || lcd->state.init_step == HD44780_INIT_DONE);
+        remaining += active[i];
+    }
+
+    while (remaining)
+    {
+        for (uint8_t i = 0; i < bus->controller_count; ++i)
+        {
+            HD44780 *lcd = bus->controllers[i];
+
+            // Controllers still executing their last operation are skipped, the others are served in the meantime.
+            if (!active[i] || (!lcd->async && !HD44780_is_idle(lcd)))
+            {
+                continue;
+            }
+
+            bool rs;
+            uint8_t byte;
+
+            if (HD44780_fb_next(lcd, &iterators[i], &rs, &byte))
+            {
+                HD44780_write_byte(lcd, rs, byte);
+                continue;
+            }
+
+            memset(lcd->state.fb_dirty, 0, sizeof(lcd->state.fb_dirty));
+            active[i] = false;
+            remaining--;
+        }
+    }
+}
+
+size_t HD44780_dma_compile_str(HD44780 *lcd,
+                               uint8_t column,
+                               uint8_t row,
+                               const char *str,
+                               uint32_t tick_ns,
+                               uint32_t *words,
+                               size_t capacity)
+{
+    if (!tick_ns || !HD44780_wave_supported(lcd))
+    {
+        return 0;
+    }
+
+    HD44780_Waveform wave = {.words = words, .capacity = capacity, .tick_ns = tick_ns};
+    HD44780_Tracked tracked = HD44780_save_tracked(lcd);
+
+    HD44780_wave_sink(lcd, &wave, false, HD44780_CMD_SET_DDRAM_ADDRESS | HD44780_ddram_address(lcd, column, row));
+
+    for (size_t i = 0; str[i] != '\0'; ++i)
+    {
+        HD44780_wave_sink(lcd, &wave, true, str[i]);
+    }
+
+    if (wave.count > capacity)
+    {
+        // The waveform will not be sent, undo its effect on the tracked state.
+        HD44780_restore_tracked(lcd, &tracked);
+        return 0;
+    }
+
+    return wave.count;
+}
+
+size_t HD44780_dma_compile_framebuffer(HD44780 *lcd, uint32_t tick_ns, uint32_t *words, size_t capacity)
+{
+    if (!lcd->framebuffer || !tick_ns || !HD44780_wave_supported(lcd))
+    {
+        return 0;
+    }
+
+    HD44780_Waveform wave = {.words = words, .capacity = capacity, .tick_ns = tick_ns};
+    HD44780_Tracked tracked = HD44780_save_tracked(lcd);
+
+    HD44780_fb_sync(lcd, HD44780_wave_sink, &wave);
+
+    if (wave.count > capacity)
+    {
+        // The waveform will not be sent, undo its effect on the tracked state.
+        HD44780_restore_tracked(lcd, &tracked);
+        return 0;
+    }
+
+    memset(lcd->state.fb_dirty, 0, sizeof(lcd->state.fb_dirty));
+
+    return wave.count;
+}
+
+void HD44780_dma_acquire(HD44780 *lcd)
+{
+    HD44780_lock_bus(lcd);
+
+    // The waveforms are not supported through a transport, which has no pins to prepare.
+    if (lcd->transport)
+    {
+        return;
+    }
+
+    // The waveform only drives RS, EN and the data lines.
+    HD44780_set_data_mode(lcd, false);
+
+    if (!lcd->write_only)
+    {
+        GPIO_reset(lcd->rw_gpio, lcd->rw_pin);
+    }
+}
+
+void HD44780_dma_release(HD44780 *lcd)
+{
+    HD44780_unlock_bus(lcd);
+}
+
+#if defined(HAL_DMA_MODULE_ENABLED) && defined(HAL_TIM_MODULE_ENABLED)
+
+HAL_StatusTypeDef HD44780_dma_start(HD44780 *lcd, TIM_HandleTypeDef *htim, const uint32_t *words, size_t count)
+{
+    if (lcd->transport)
+    {
+        return HAL_ERROR;
+    }
+
+    HD44780_dma_acquire(lcd);
+
+    HAL_StatusTypeDef status =
+        HAL_DMA_Start(htim->hdma[TIM_DMA_ID_UPDATE], (uint32_t)words, (uint32_t)&lcd->en_gpio->BSRR, count);
+
+    if (status != HAL_OK)
+    {
+        HD44780_dma_release(lcd);
+        return status;
+    }
+
+    __HAL_TIM_ENABLE_DMA(htim, TIM_DMA_UPDATE);
+
+    return HAL_TIM_Base_Start(htim);
+}
+
+bool HD44780_dma_busy(TIM_HandleTypeDef *htim)
+{
+    return __HAL_DMA_GET_COUNTER(htim->hdma[TIM_DMA_ID_UPDATE]) != 0;
+}
+
+void HD44780_dma_stop(HD44780 *lcd, TIM_HandleTypeDef *htim)
+{
+    HAL_TIM_Base_Stop(htim);
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE);
+    HAL_DMA_Abort(htim->hdma[TIM_DMA_ID_UPDATE]);
+
+    HD44780_dma_release(lcd);
+}
+
+#endif
+
+#if defined(HAL_I2C_MODULE_ENABLED)
+
+const HD44780_Transport HD44780_pcf8574_transport = {
+    .init = HD44780_pcf8574_init,
+    .write = HD44780_pcf8574_write,
+    .write_init = HD44780_pcf8574_write_init,
+};
+
+void HD44780_pcf8574_backlight(HD44780 *lcd, bool on)
+{
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+
+    HD44780_lock_bus(lcd);
+
+    pcf->backlight = on;
+    HD44780_pcf8574_push(pcf, on ? HD44780_PCF8574_BACKLIGHT : 0);
+    HD44780_pcf8574_transmit(pcf);
+
+    HD44780_unlock_bus(lcd);
+}
+
+#endif
+
+/*
+ * Internal function definitions
+ */
+
+static inline void GPIO_init(GPIO_TypeDef *gpio, uint16_t pin, uint32_t mode)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {.Pull = GPIO_NOPULL, .Speed = GPIO_SPEED_FREQ_HIGH, .Pin = pin, .Mode = mode};
+    HAL_GPIO_Init(gpio, &GPIO_InitStruct);
+}
+
+static void HD44780_init_data_ports(HD44780 *lcd)
+{
+    GPIO_TypeDef *gpios[8] = {lcd->d0_gpio, lcd->d1_gpio, lcd->d2_gpio, lcd->d3_gpio,
+                              lcd->d4_gpio, lcd->d5_gpio, lcd->d6_gpio, lcd->d7_gpio};
+    uint16_t pins[8] = {lcd->d0_pin, lcd->d1_pin, lcd->d2_pin, lcd->d3_pin,
+                        lcd->d4_pin, lcd->d5_pin, lcd->d6_pin, lcd->d7_pin};
+
+    memset(lcd->state.data_ports, 0, sizeof(lcd->state.data_ports));
+    lcd->state.data_port_count = 0;
+
+    // In 4 bit mode DB3 to DB0 are not connected.
+    for (uint8_t line = lcd->interface_8_bit ? 0 : 4; line < 8; ++line)
+    {
+        HD44780_DataPort *port = NULL;
+
+        for (uint8_t i = 0; i < lcd->state.data_port_count; ++i)
+        {
+            if (lcd->state.data_ports[i].gpio == gpios[line])
+            {
+                port = &lcd->state.data_ports[i];
+            }
+        }
+
+        if (!port)
+        {
+            if (lcd->state.data_port_count == HD44780_MAX_DATA_PORTS)
+            {
+                // Too many ports, fall back to writing each pin separately.
+                lcd->state.data_port_count = 0;
+                return;
+            }
+
+            port = &lcd->state.data_ports[lcd->state.data_port_count++];
+            port->gpio = gpios[line];
+        }
+
+        port->pins |= pins[line];
+        port->line_pins[line] = pins[line];
+
+        for (uint8_t index = 0; index < 16; ++index)
+        {
+            if (pins[line] & (1 << index))
+            {
+#if defined(STM32F1)
+                port->cr_mask[index / 8] |= 0xFu << (index % 8 * 4);
+#else
+                port->moder_mask |= 0x3u << (index * 2);
+#endif
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < lcd->state.data_port_count; ++i)
+    {
+        HD44780_DataPort *port = &lcd->state.data_ports[i];
+
+        for (uint8_t nibble = 0; nibble < 16; ++nibble)
+        {
+            for (uint8_t bit = 0; bit < 4; ++bit)
+            {
+                if (nibble & (1 << bit))
+                {
+                    port->set_low[nibble] |= port->line_pins[bit];
+                    port->set_high[nibble] |= port->line_pins[bit + 4];
+                }
+            }
+        }
+    }
+}
+
+static void HD44780_init_data_pins(HD44780 *lcd, uint32_t mode)
+{
+    GPIO_init(lcd->d7_gpio, lcd->d7_pin, mode);
+    GPIO_init(lcd->d6_gpio, lcd->d6_pin, mode);
+    GPIO_init(lcd->d5_gpio, lcd->d5_pin, mode);
+    GPIO_init(lcd->d4_gpio, lcd->d4_pin, mode);
+
+    if (lcd->interface_8_bit)
+    {
+        GPIO_init(lcd->d3_gpio, lcd->d3_pin, mode);
+        GPIO_init(lcd->d2_gpio, lcd->d2_pin, mode);
+        GPIO_init(lcd->d1_gpio, lcd->d1_pin, mode);
         GPIO_init(lcd->d0_gpio, lcd->d0_pin, mode);
     }
 }
 
-static uint8_t HD44780_pull_value(const HD44780 *lcd)
+static void HD44780_init_instance(HD44780 *lcd)
+{
+    delay_init();
+
+#if defined(HD44780_STATS)
+    memset(&lcd->stats, 0, sizeof(lcd->stats));
+#endif
+
+    if (lcd->transport)
+    {
+        // The controller cannot be read through a transport, the execution times are waited instead. The transports
+        // only drive DB4 to DB7, and cannot share the pins of a bus.
+        lcd->write_only = true;
+        lcd->interface_8_bit = false;
+        lcd->bus = NULL;
+        lcd->state.data_port_count = 0;
+    }
+    else
+    {
+        HD44780_init_data_ports(lcd);
+    }
+
+    lcd->state.queue_head = 0;
+    lcd->state.queue_tail = 0;
+    lcd->state.exec_pending = false;
+    lcd->state.bus_locked = false;
+    lcd->state.init_step = HD44780_INIT_DONE;
+
+    HD44780_init_geometry(lcd);
+
+    if (lcd->bus)
+    {
+        HD44780_Bus *bus = lcd->bus;
+        bool registered = false;
+
+        for (uint8_t i = 0; i < bus->controller_count; ++i)
+        {
+            registered |= bus->controllers[i] == lcd;
+        }
+
+        if (!registered && bus->controller_count < HD44780_MAX_BUS_CONTROLLERS)
+        {
+            bus->controllers[bus->controller_count++] = lcd;
+        }
+    }
+
+    // The clear display instruction sent by HD44780_init_configuration() resets the address counter and selects the
+    // increment mode.
+    lcd->state.address = 0;
+    lcd->state.address_cgram = false;
+    lcd->state.address_increment = true;
+    lcd->state.shift_on_write = false;
+    lcd->state.display_shift = 0;
+    lcd->state.page_offset = 0;
+
+    lcd->state.cgram_valid = 0;
+    lcd->state.glyph_clock = 0;
+    memset(lcd->state.glyph_used, 0, sizeof(lcd->state.glyph_used));
+
+    for (HD44780_ExecClass i = HD44780_EXEC_DATA; i <= HD44780_EXEC_LONG; ++i)
+    {
+        lcd->state.exec_estimate[i] = HD44780_nominal_execution_time(i);
+    }
+
+
+    *HD44780_data_input(lcd) = false;
+
+    if (lcd->transport)
+    {
+        if (lcd->transport->init)
+        {
+            lcd->transport->init(lcd);
+        }
+    }
+    else
+    {
+        GPIO_init(lcd->rs_gpio, lcd->rs_pin, GPIO_MODE_OUTPUT_PP);
+        GPIO_init(lcd->en_gpio, lcd->en_pin, GPIO_MODE_OUTPUT_PP);
+        HD44780_init_data_pins(lcd, GPIO_MODE_OUTPUT_PP);
+
+        if (!lcd->write_only)
+        {
+            GPIO_init(lcd->rw_gpio, lcd->rw_pin, GPIO_MODE_OUTPUT_PP);
+            HAL_GPIO_WritePin(lcd->rw_gpio, lcd->rw_pin, GPIO_PIN_RESET);
+        }
+
+        HAL_GPIO_WritePin(lcd->rs_gpio, lcd->rs_pin, GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_RESET);
+    }
+}
+
+static void HD44780_init_interface(HD44780 *lcd)
+{
+    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
+    delay_us(120); // Wait for more than 100us.
+    HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
+    delay_us(50); // BF cannot be checked before this instruction, wait more than 37us.
+
+    if (!lcd->interface_8_bit)
+    {
+        HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_4BIT);
+        delay_us(50); // BF cannot be checked before this instruction, wait more than 37us.
+    }
+}
+
+static void HD44780_init_configuration(HD44780 *lcd)
+{
+    uint8_t flg_data_len = lcd->interface_8_bit ? HD44780_FLG_DATA_LEN_8BIT : HD44780_FLG_DATA_LEN_4BIT;
+    uint8_t flg_line_qty = lcd->single_line ? HD44780_FLG_1_LINE : HD44780_FLG_2_LINE;
+    uint8_t flg_font_size = lcd->font_5x10 ? HD44780_FLG_FONT_5X10 : HD44780_FLG_FONT_5X8;
+
+    HD44780_write_instruction(lcd, HD44780_CMD_FUNCTION_SET | flg_data_len | flg_line_qty | flg_font_size);
+    HD44780_write_instruction(lcd, HD44780_CMD_DISPLAY_CONTROL);
+    HD44780_write_instruction(lcd, HD44780_CMD_CLEAR_DISPLAY);
+    lcd->state.entry_mode = HD44780_CMD_ENTRY_MODE_SET | HD44780_FLG_DISPLAY_NOSHIFT | HD44780_FLG_DIR_LTR;
+    HD44780_write_instruction(lcd, lcd->state.entry_mode);
+    HD44780_write_instruction(lcd, HD44780_CMD_DISPLAY_CONTROL | HD44780_FLG_DISPLAY_ON | HD44780_FLG_CURSOR_OFF |
+                                       HD44780_FLG_BLINK_OFF);
+
+    // The clear display instruction filled the DDRAM with spaces, so the framebuffer starts in sync.
+    if (lcd->framebuffer)
+    {
+        memset(lcd->framebuffer, ' ', HD44780_DDRAM_SIZE);
+        memset(lcd->state.fb_dirty, 0, sizeof(lcd->state.fb_dirty));
+        lcd->state.fb_cursor = 0;
+    }
+}
+
+static uint32_t HD44780_tick_remaining(uint32_t since, uint32_t ns)
+{
+    // A difference of n ticks only guarantees that more than n - 1 ms elapsed.
+    uint32_t ticks = HAL_GetTick() - since;
+    uint32_t elapsed_ms = ticks ? ticks - 1 : 0;
+
+    return elapsed_ms >= (ns + 999999) / 1000000 ? 0 : ns - elapsed_ms * 1000000;
+}
+
+static void HD44780_init_advance(HD44780 *lcd)
+{
+    HD44780_State *state = &lcd->state;
+
+    if (state->init_step == HD44780_INIT_POWER_ON)
+    {
+        if (HD44780_tick_remaining(state->init_tick, HD44780_T_POWER_ON))
+        {
+            return;
+        }
+
+        HD44780_write_init(lcd, HD44780_CMD_FUNCTION_SET | HD44780_FLG_DATA_LEN_8BIT);
+        state->init_tick = HAL_GetTick();
+        state->init_step = HD44780_INIT_RESET;
+    }
+
+    if (state->init_step == HD44780_INIT_RESET)
+    {
+        if (HD44780_tick_remaining(state->init_tick, HD44780_T_RESET))
+        {
+            return;
+        }
+
+        // The remaining waits are shorter than a tick, they are performed in place.
+        HD44780_init_interface(lcd);
+        HD44780_init_complete(lcd);
+    }
+}
+
+static void HD44780_init_complete(HD44780 *lcd)
+{
+    lcd->state.init_step = HD44780_INIT_DONE;
+
+    // In asynchronous mode the queue keeps being drained by HD44780_poll().
+    if (lcd->async)
+    {
+        return;
+    }
+
+    while (lcd->state.queue_head != lcd->state.queue_tail)
+    {
+        uint16_t entry = lcd->state.queue[lcd->state.queue_tail];
+        lcd->state.queue_tail = (lcd->state.queue_tail + 1) % HD44780_QUEUE_SIZE;
+
+        uint32_t start = HD44780_transaction_begin(lcd);
+        HD44780_transmit_byte(lcd, entry >> 8, entry);
+        HD44780_await_execution(lcd, entry >> 8, entry);
+        HD44780_transaction_end(lcd, start);
+    }
+
+    // The framebuffer flushes were postponed, the changed characters are sent once the configuration is executed.
+    HD44780_flush(lcd);
+}
+
+static inline void HD44780_set_data_mode(HD44780 *lcd, bool input)
+{
+    bool *data_input = HD44780_data_input(lcd);
+
+    if (*data_input == input)
+    {
+        return;
+    }
+
+    // A transport has no data pins to switch.
+    if (lcd->transport)
+    {
+        return;
+    }
+
+    *data_input = input;
+    HD44780_STAT(lcd, direction_switches, 1);
+
+    if (!lcd->state.data_port_count)
+    {
+        HD44780_init_data_pins(lcd, input ? GPIO_MODE_INPUT : GPIO_MODE_OUTPUT_PP);
+        return;
+    }
+
+    // The pins were fully configured by HD44780_init(), so only the direction bits need to be updated.
+    for (uint8_t i = 0; i < lcd->state.data_port_count; ++i)
+    {
+        const HD44780_DataPort *port = &lcd->state.data_ports[i];
+
+#if defined(STM32F1)
+        // Input: floating input (CNF = 01, MODE = 00). Output: push-pull, 50MHz (CNF = 00, MODE = 11).
+        uint32_t config = input ? 0x44444444 : 0x33333333;
+
+        if (port->cr_mask[0])
+        {
+            uint32_t crl = HD44780_GPIO_READ(port->gpio, CRL);
+            HD44780_GPIO_WRITE(port->gpio, CRL, (crl & ~port->cr_mask[0]) | (config & port->cr_mask[0]));
+        }
+
+        if (port->cr_mask[1])
+        {
+            uint32_t crh = HD44780_GPIO_READ(port->gpio, CRH);
+            HD44780_GPIO_WRITE(port->gpio, CRH, (crh & ~port->cr_mask[1]) | (config & port->cr_mask[1]));
+        }
+#else
+        // Input: MODE = 00. Output: MODE = 01, output type, speed and pull were set by HD44780_init().
+        uint32_t config = input ? 0x00000000 : 0x55555555;
+        uint32_t moder = HD44780_GPIO_READ(port->gpio, MODER);
+        HD44780_GPIO_WRITE(port->gpio, MODER, (moder & ~port->moder_mask) | (config & port->moder_mask));
+#endif
+    }
+}
+
+static uint8_t HD44780_pull_value(HD44780 *lcd)
+{
+    HD44780_set_enable(lcd, true);
+
+    delay_timing(DELAY_ENABLE_READ);
+
+    uint8_t value = 0;
+
+    if (lcd->state.data_port_count)
+    {
+        for (uint8_t i = 0; i < lcd->state.data_port_count; ++i)
+        {
+            const HD44780_DataPort *port = &lcd->state.data_ports[i];
+            uint16_t idr = HD44780_GPIO_READ(port->gpio, IDR);
+
+            for (uint8_t line = 0; line < 8; ++line)
+            {
+                value |= (idr & port->line_pins[line]) ? 1 << line : 0;
+            }
+        }
+
+        if (!lcd->interface_8_bit)
+        {
+            value >>= 4;
+        }
+    }
+    else if (lcd->interface_8_bit)
+    {
+        value |= HAL_GPIO_ReadPin(lcd->d7_gpio, lcd->d7_pin) << 7;
+        value |= HAL_GPIO_ReadPin(lcd->d6_gpio, lcd->d6_pin) << 6;
+        value |= HAL_GPIO_ReadPin(lcd->d5_gpio, lcd->d5_pin) << 5;
+        value |= HAL_GPIO_ReadPin(lcd->d4_gpio, lcd->d4_pin) << 4;
+        value |= HAL_GPIO_ReadPin(lcd->d3_gpio, lcd->d3_pin) << 3;
+        value |= HAL_GPIO_ReadPin(lcd->d2_gpio, lcd->d2_pin) << 2;
+        value |= HAL_GPIO_ReadPin(lcd->d1_gpio, lcd->d1_pin) << 1;
+        value |= HAL_GPIO_ReadPin(lcd->d0_gpio, lcd->d0_pin) << 0;
+    }
+    else
+    {
+        value |= HAL_GPIO_ReadPin(lcd->d7_gpio, lcd->d7_pin) << 3;
+        value |= HAL_GPIO_ReadPin(lcd->d6_gpio, lcd->d6_pin) << 2;
+        value |= HAL_GPIO_ReadPin(lcd->d5_gpio, lcd->d5_pin) << 1;
+        value |= HAL_GPIO_ReadPin(lcd->d4_gpio, lcd->d4_pin) << 0;
+    }
+
+    HD44780_set_enable(lcd, false);
+
+    return value;
+}
+
+static void HD44780_push_value(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_set_enable(lcd, true);
+    HD44780_drive_data(lcd, byte);
+
+    delay_timing(DELAY_ENABLE_WRITE);
+
+    HD44780_set_enable(lcd, false);
+
+    // Address hold time = 20ns
+}
+
+static void HD44780_drive_data(HD44780 *lcd, uint8_t byte)
+{
+    if (lcd->state.data_port_count)
+    {
+        for (uint8_t i = 0; i < lcd->state.data_port_count; ++i)
+        {
+            const HD44780_DataPort *port = &lcd->state.data_ports[i];
+
+            uint16_t set = lcd->interface_8_bit ? port->set_high[(byte >> 4) & 0x0F] | port->set_low[byte & 0x0F]
+                                                : port->set_high[byte & 0x0F];
+
+            HD44780_GPIO_WRITE(port->gpio, BSRR, set | (uint32_t)(port->pins & ~set) << 16);
+        }
+    }
+    else if (lcd->interface_8_bit)
+    {
+        HAL_GPIO_WritePin(lcd->d7_gpio, lcd->d7_pin, byte & (1 << 7) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d6_gpio, lcd->d6_pin, byte & (1 << 6) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d5_gpio, lcd->d5_pin, byte & (1 << 5) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d4_gpio, lcd->d4_pin, byte & (1 << 4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d3_gpio, lcd->d3_pin, byte & (1 << 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d2_gpio, lcd->d2_pin, byte & (1 << 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d1_gpio, lcd->d1_pin, byte & (1 << 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d0_gpio, lcd->d0_pin, byte & (1 << 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    }
+    else
+    {
+        HAL_GPIO_WritePin(lcd->d7_gpio, lcd->d7_pin, byte & (1 << 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d6_gpio, lcd->d6_pin, byte & (1 << 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d5_gpio, lcd->d5_pin, byte & (1 << 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(lcd->d4_gpio, lcd->d4_pin, byte & (1 << 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    }
+}
+
+static uint8_t HD44780_read_byte(HD44780 *lcd, bool rs)
+{
+    GPIO_set(lcd->rw_gpio, lcd->rw_pin);
+
+    if (rs)
+    {
+        GPIO_set(lcd->rs_gpio, lcd->rs_pin);
+    }
+    else
+    {
+        GPIO_reset(lcd->rs_gpio, lcd->rs_pin);
+    }
+
+    HD44780_set_data_mode(lcd, true);
+
+    delay_timing(DELAY_ADDRESS_SETUP);
+    HD44780_STAT(lcd, en_pulses, lcd->interface_8_bit ? 1 : 2);
+
+    uint8_t byte = 0;
+
+    if (lcd->interface_8_bit)
+    {
+        byte = HD44780_pull_value(lcd);
+    }
+    else
+    {
+        byte |= HD44780_pull_value(lcd) << 4;
+        delay_timing(DELAY_ENABLE_LOW_READ);
+        byte |= HD44780_pull_value(lcd);
+    }
+
+    return byte;
+}
+
+static void HD44780_select_register(HD44780 *lcd, bool rs)
+{
+    HD44780_set_data_mode(lcd, false);
+
+    if (!lcd->write_only)
+    {
+        GPIO_reset(lcd->rw_gpio, lcd->rw_pin);
+    }
+
+    if (rs)
+    {
+        GPIO_set(lcd->rs_gpio, lcd->rs_pin);
+    }
+    else
+    {
+        GPIO_reset(lcd->rs_gpio, lcd->rs_pin);
+    }
+
+    delay_timing(DELAY_ADDRESS_SETUP);
+}
+
+static inline void HD44780_push_byte(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_STAT(lcd, en_pulses, lcd->interface_8_bit ? 1 : 2);
+
+    if (lcd->interface_8_bit)
+    {
+        HD44780_push_value(lcd, byte);
+    }
+    else
+    {
+        HD44780_push_value(lcd, byte >> 4);
+        delay_timing(DELAY_ENABLE_LOW_WRITE);
+        HD44780_push_value(lcd, byte);
+    }
+}
+
+static void HD44780_transmit_byte(HD44780 *lcd, bool rs, uint8_t byte)
+{
+    if (rs)
+    {
+        HD44780_STAT(lcd, data_writes, 1);
+    }
+    else
+    {
+        HD44780_STAT(lcd, instructions, 1);
+    }
+
+    if (lcd->transport)
+    {
+        HD44780_STAT(lcd, en_pulses, lcd->interface_8_bit ? 1 : 2);
+        lcd->transport->write(lcd, rs, &byte, 1);
+        return;
+    }
+
+    if (lcd->transmit && !lcd->bus)
+    {
+        HD44780_STAT(lcd, en_pulses, lcd->interface_8_bit ? 1 : 2);
+        HD44780_set_data_mode(lcd, false);
+        lcd->transmit(lcd, rs, byte);
+        return;
+    }
+
+    HD44780_select_register(lcd, rs);
+    HD44780_push_byte(lcd, byte);
+}
+
+static void HD44780_write_run(HD44780 *lcd, const uint8_t *data, size_t len)
+{
+    bool ltr = lcd->state.entry_mode & HD44780_FLG_DIR_LTR;
+
+    // When the display shifts along with the cursor, the rows have no fixed end to wrap at.
+    bool wrap = lcd->columns && !(lcd->state.entry_mode & HD44780_FLG_DISPLAY_SHIFT);
+
+    while (len)
+    {
+        uint8_t column, row;
+
+        if (!wrap || !HD44780_locate(lcd, HD44780_cursor_address(lcd), &column, &row))
+        {
+            HD44780_write_span(lcd, data, len);
+            return;
+        }
+
+        // Write up to the last visible column in the writing direction, then move to the adjacent row.
+        size_t room = ltr ? lcd->columns - column : column + 1;
+        size_t n = len < room ? len : room;
+
+        HD44780_write_span(lcd, data, n);
+        data += n;
+        len -= n;
+
+        if (n < room)
+        {
+            return;
+        }
+
+        uint8_t rows = lcd->state.row_count;
+        uint8_t next_column = ltr ? 0 : lcd->columns - 1;
+        uint8_t next_row = ltr ? (row + 1) % rows : (row + rows - 1) % rows;
+
+        // In single line mode the rows are contiguous, the address counter is already in place.
+        if (HD44780_cursor_address(lcd) != HD44780_ddram_address(lcd, next_column, next_row))
+        {
+            HD44780_cursor_to(lcd, next_column, next_row);
+        }
+    }
+}
+
+static void HD44780_write_span(HD44780 *lcd, const uint8_t *data, size_t len)
+{
+    if (lcd->framebuffer)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            HD44780_write_character(lcd, data[i]);
+        }
+
+        return;
+    }
+
+    HD44780_send_data(lcd, data, len);
+}
+
+static void HD44780_send_data(HD44780 *lcd, const uint8_t *data, size_t len)
+{
+    if (!len)
+    {
+        return;
+    }
+
+    // Queued and bus operations are not waited for in place, there is no setup to save.
+    if (HD44780_is_queued(lcd) || lcd->bus)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            HD44780_write_data(lcd, data[i]);
+        }
+
+        return;
+    }
+
+    uint32_t start = HD44780_transaction_begin(lcd);
+    HD44780_STAT(lcd, data_writes, len);
+
+    // The transport paces the whole run on its own.
+    if (lcd->transport)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            HD44780_track_address(lcd, true, data[i]);
+        }
+
+        HD44780_STAT(lcd, en_pulses, (lcd->interface_8_bit ? 1 : 2) * len);
+        lcd->transport->write(lcd, true, data, len);
+        HD44780_transaction_end(lcd, start);
+        return;
+    }
+
+    // The specialized transfer selects the register on its own, with a single store.
+    if (lcd->transmit)
+    {
+        HD44780_STAT(lcd, en_pulses, (lcd->interface_8_bit ? 1 : 2) * len);
+
+        for (size_t i = 0; i < len; ++i)
+        {
+            HD44780_set_data_mode(lcd, false);
+            HD44780_track_address(lcd, true, data[i]);
+            lcd->transmit(lcd, true, data[i]);
+            HD44780_await_execution(lcd, true, data[i]);
+        }
+
+        HD44780_transaction_end(lcd, start);
+        return;
+    }
+
+    // The control lines are only set up again when a busy flag read turned the bus around since the last byte.
+    HD44780_select_register(lcd, true);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (*HD44780_data_input(lcd))
+        {
+            HD44780_select_register(lcd, true);
+        }
+
+        HD44780_track_address(lcd, true, data[i]);
+        HD44780_push_byte(lcd, data[i]);
+        HD44780_await_execution(lcd, true, data[i]);
+    }
+
+    HD44780_transaction_end(lcd, start);
+}
+
+static inline uint32_t HD44780_stats_clock(void)
+{
+#if defined(HD44780_STATS)
+    return HD44780_CYCLES();
+#else
+    return 0;
+#endif
+}
+
+static inline uint32_t HD44780_transaction_begin(HD44780 *lcd)
+{
+#if defined(HD44780_STATS)
+    if (lcd->trace)
+    {
+        lcd->trace(lcd, true);
+    }
+#else
+    (void)lcd;
+#endif
+
+    return HD44780_stats_clock();
+}
+
+static inline void HD44780_transaction_end(HD44780 *lcd, uint32_t start)
+{
+#if defined(HD44780_STATS)
+    uint32_t cycles = HD44780_stats_clock() - start;
+
+    lcd->stats.transactions++;
+    lcd->stats.bus_cycles += cycles;
+
+    if (cycles > lcd->stats.max_transaction_cycles)
+    {
+        lcd->stats.max_transaction_cycles = cycles;
+    }
+
+    if (lcd->trace)
+    {
+        lcd->trace(lcd, false);
+    }
+#else
+    (void)lcd;
+    (void)start;
+#endif
+}
+
+static inline bool HD44780_is_queued(HD44780 *lcd)
+{
+    return lcd->async || lcd->state.init_step != HD44780_INIT_DONE;
+}
+
+static void HD44780_write_byte(HD44780 *lcd, bool rs, uint8_t byte)
+{
+    HD44780_track_address(lcd, rs, byte);
+
+    if (HD44780_is_queued(lcd))
+    {
+        uint8_t head = lcd->state.queue_head;
+        uint8_t next = (head + 1) % HD44780_QUEUE_SIZE;
+
+        // Queue full, make room by draining it. Outside of the asynchronous mode the whole queue is sent when the
+        // initialization completes, then the byte is written in place.
+        while (next == lcd->state.queue_tail && HD44780_is_queued(lcd))
+        {
+            HD44780_poll(lcd);
+        }
+
+        if (HD44780_is_queued(lcd))
+        {
+            lcd->state.queue[head] = (uint16_t)rs << 8 | byte;
+            lcd->state.queue_head = next;
+            return;
+        }
+    }
+
+    if (lcd->bus)
+    {
+        volatile bool *locked = HD44780_bus_lock(lcd);
+        bool was_locked = *locked;
+        *locked = true;
+
+        HD44780_await_pending(lcd);
+
+        uint32_t start = HD44780_transaction_begin(lcd);
+        HD44780_transmit_byte(lcd, rs, byte);
+
+        // The busy flag is checked before the next access, meanwhile the other controllers can be accessed.
+        if (lcd->write_only)
+        {
+            HD44780_await_execution(lcd, rs, byte);
+        }
+        else
+        {
+            HD44780_set_pending(lcd, rs, byte);
+        }
+
+        HD44780_transaction_end(lcd, start);
+        *locked = was_locked;
+        return;
+    }
+
+    uint32_t start = HD44780_transaction_begin(lcd);
+    HD44780_transmit_byte(lcd, rs, byte);
+    HD44780_await_execution(lcd, rs, byte);
+    HD44780_transaction_end(lcd, start);
+
+    // The address counter is updated 4us after the busy flag turns off, but it is never read back: the driver keeps
+    // its own copy, so no additional wait is needed after data writes.
+}
+
+static void HD44780_write_init(HD44780 *lcd, uint8_t byte)
+{
+    uint32_t start = HD44780_transaction_begin(lcd);
+    HD44780_STAT(lcd, instructions, 1);
+    HD44780_STAT(lcd, en_pulses, 1);
+
+    if (lcd->transport)
+    {
+        lcd->transport->write_init(lcd, byte);
+        HD44780_transaction_end(lcd, start);
+        return;
+    }
+
+    // Between the steps of HD44780_init_start() the other controllers on the bus may have turned the lines around.
+    HD44780_select_register(lcd, false);
+
+    if (lcd->interface_8_bit)
+    {
+        HD44780_push_value(lcd, byte);
+    }
+    else
+    {
+        HD44780_push_value(lcd, byte >> 4);
+    }
+
+    HD44780_transaction_end(lcd, start);
+}
+
+static void HD44780_lock_bus(HD44780 *lcd)
+{
+    if (!HD44780_is_queued(lcd) && !lcd->bus)
+    {
+        return;
+    }
+
+    HD44780_drain(lcd);
+    *HD44780_bus_lock(lcd) = true;
+}
+
+static inline void HD44780_unlock_bus(HD44780 *lcd)
+{
+    *HD44780_bus_lock(lcd) = false;
+}
+
+static inline uint8_t HD44780_get_busyflag(HD44780 *lcd)
+{
+    HD44780_STAT(lcd, busy_polls, 1);
+
+    return HD44780_read_byte(lcd, false) >> HD44780_CMD_READ_BUSYFLAG_AND_ADDRESS & 1;
+}
+
+static inline uint8_t HD44780_address_instruction(HD44780 *lcd)
+{
+    if (lcd->state.address_cgram)
+    {
+        return HD44780_CMD_SET_CGRAM_ADDRESS | lcd->state.address;
+    }
+
+    return HD44780_CMD_SET_DDRAM_ADDRESS | lcd->state.address;
+}
+
+static void HD44780_send_instruction(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_track_address(lcd, false, byte);
+    HD44780_transmit_byte(lcd, false, byte);
+    HD44780_await_execution(lcd, false, byte);
+}
+
+static uint8_t HD44780_acquire_ram(HD44780 *lcd)
+{
+    HD44780_lock_bus(lcd);
+    HD44780_await_pending(lcd);
+
+    return HD44780_address_instruction(lcd);
+}
+
+static void HD44780_release_ram(HD44780 *lcd, uint8_t restore)
+{
+    if (HD44780_address_instruction(lcd) != restore)
+    {
+        uint32_t start = HD44780_transaction_begin(lcd);
+        HD44780_send_instruction(lcd, restore);
+        HD44780_transaction_end(lcd, start);
+    }
+
+    HD44780_unlock_bus(lcd);
+}
+
+static void HD44780_read_run(HD44780 *lcd, bool cgram, uint8_t address, uint8_t *data, size_t len)
+{
+    bool increment = lcd->state.address_increment;
+    uint8_t first = address;
+
+    // With I/D = 0 the address counter moves backwards after each read, the run is read from its last address.
+    if (!increment)
+    {
+        first = cgram ? (address + len - 1) % HD44780_CGRAM_SIZE
+                      : HD44780_fb_address(lcd, (HD44780_fb_index(lcd, address) + len - 1) % HD44780_DDRAM_SIZE);
+    }
+
+    uint32_t start = HD44780_transaction_begin(lcd);
+
+    // The data register holds the last written byte until an address instruction loads it from RAM.
+    HD44780_send_instruction(lcd, (cgram ? HD44780_CMD_SET_CGRAM_ADDRESS : HD44780_CMD_SET_DDRAM_ADDRESS) | first);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        HD44780_STAT(lcd, data_reads, 1);
+        data[increment ? i : len - 1 - i] = HD44780_read_byte(lcd, true);
+
+        // Each read moves the address counter and loads the next byte, taking as long as a data write.
+        HD44780_step_address(lcd, increment);
+        HD44780_await_execution(lcd, true, 0);
+    }
+
+    HD44780_transaction_end(lcd, start);
+}
+
+static inline void HD44780_write_instruction(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_write_byte(lcd, 0, byte);
+}
+
+static inline void HD44780_write_data(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_write_byte(lcd, 1, byte);
+}
+
+static void HD44780_init_geometry(HD44780 *lcd)
+{
+    uint8_t rows = lcd->rows ? lcd->rows : lcd->single_line ? 1 : 2;
+    lcd->state.row_count = rows < HD44780_MAX_ROWS ? rows : HD44780_MAX_ROWS;
+
+    // Rows past the DDRAM lines continue them after the visible columns, e.g. 0x00, 0x40, 0x14, 0x54 on 20x4 modules.
+    for (uint8_t row = 0; row < HD44780_MAX_ROWS; ++row)
+    {
+        if (lcd->single_line)
+        {
+            lcd->state.row_offsets[row] = row * lcd->columns;
+        }
+        else
+        {
+            uint8_t start = row % 2 ? HD44780_SECOND_LINE_ADDRESS : 0;
+            lcd->state.row_offsets[row] = start + (row / 2) * lcd->columns;
+        }
+    }
+}
+
+static inline uint8_t HD44780_row_width(HD44780 *lcd)
+{
+    if (lcd->columns)
+    {
+        return lcd->columns;
+    }
+
+    return lcd->single_line ? HD44780_DDRAM_SIZE : HD44780_LINE_LENGTH;
+}
+
+static inline uint8_t HD44780_cursor_address(HD44780 *lcd)
+{
+    return lcd->framebuffer ? HD44780_fb_address(lcd, lcd->state.fb_cursor) : lcd->state.address;
+}
+
+static bool HD44780_locate(HD44780 *lcd, uint8_t address, uint8_t *column, uint8_t *row)
+{
+    if (!lcd->framebuffer && lcd->state.address_cgram)
+    {
+        return false;
+    }
+
+    uint8_t width = HD44780_row_width(lcd);
+
+    for (uint8_t i = 0; i < lcd->state.row_count; ++i)
+    {
+        uint8_t start = lcd->state.row_offsets[i] + lcd->state.page_offset;
+
+        if (address >= start && address - start < width)
+        {
+            *column = address - start;
+            *row = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint8_t HD44780_get_current_row(HD44780 *lcd)
+{
+    uint8_t address = HD44780_cursor_address(lcd);
+    uint8_t column, row;
+
+    if (HD44780_locate(lcd, address, &column, &row))
+    {
+        return row;
+    }
+
+    bool second_line = !lcd->single_line && address >= HD44780_SECOND_LINE_ADDRESS;
+    return second_line % lcd->state.row_count;
+}
+
+static void HD44780_write_character(HD44780 *lcd, uint8_t chr)
+{
+    if (!lcd->framebuffer)
+    {
+        HD44780_write_data(lcd, chr);
+        return;
+    }
+
+    uint8_t index = lcd->state.fb_cursor;
+
+    if (lcd->framebuffer[index] != chr)
+    {
+        lcd->framebuffer[index] = chr;
+        lcd->state.fb_dirty[index / 8] |= 1 << (index % 8);
+    }
+
+    // The framebuffer index space wraps around from the last to the first position in both one and two lines mode,
+    // the same way the controller address counter does.
+    if (lcd->state.entry_mode & HD44780_FLG_DIR_LTR)
+    {
+        lcd->state.fb_cursor = index + 1 < HD44780_DDRAM_SIZE ? index + 1 : 0;
+    }
+    else
+    {
+        lcd->state.fb_cursor = index ? index - 1 : HD44780_DDRAM_SIZE - 1;
+    }
+}
+
+static inline uint8_t HD44780_fb_index(HD44780 *lcd, uint8_t address)
+{
+    if (!lcd->single_line && address >= HD44780_SECOND_LINE_ADDRESS)
+    {
+        return (HD44780_LINE_LENGTH + address - HD44780_SECOND_LINE_ADDRESS) % HD44780_DDRAM_SIZE;
+    }
+
+    return address % HD44780_DDRAM_SIZE;
+}
+
+static inline uint8_t HD44780_fb_address(HD44780 *lcd, uint8_t index)
+{
+    if (!lcd->single_line && index >= HD44780_LINE_LENGTH)
+    {
+        return HD44780_SECOND_LINE_ADDRESS + index - HD44780_LINE_LENGTH;
+    }
+
+    return index;
+}
+
+static inline bool HD44780_fb_is_dirty(HD44780 *lcd, uint8_t index)
+{
+    return lcd->state.fb_dirty[index / 8] & (1 << (index % 8));
+}
+
+static inline void HD44780_await_busyflag(HD44780 *lcd, HD44780_ExecClass exec_class, uint32_t elapsed, bool exact)
+{
+    uint32_t estimate = lcd->state.exec_estimate[exec_class];
+
+    uint32_t start = HD44780_stats_clock();
+
+    // Sleeping through the rest of the execution time avoids bus turnarounds that would only read BF = 1.
+    uint32_t waited = elapsed < estimate ? estimate - elapsed : 0;
+    delay_ns(waited);
+
+    if (!HD44780_get_busyflag(lcd))
+    {
+        // Finished in time, a slightly shorter wait is tried next time. Probing slowly keeps most operations to a
+        // single poll. An operation already older than the estimate tells nothing about it.
+        if (exact && waited)
+        {
+            lcd->state.exec_estimate[exec_class] = estimate - estimate / 512;
+        }
+
+        HD44780_STAT(lcd, busy_wait_cycles, HD44780_stats_clock() - start);
+        return;
+    }
+
+    uint32_t step = estimate / 64;
+
+    do
+    {
+        delay_ns(step);
+        waited += step;
+    } while (HD44780_get_busyflag(lcd));
+
+    HD44780_STAT(lcd, busy_wait_cycles, HD44780_stats_clock() - start);
+
+    // The measured time, plus a margin that lasts for a few probes, covers the next operations. A single slow
+    // operation, e.g. polled around an interrupt, only raises the estimate by an eighth. The estimate is capped to twice
+    // the datasheet time, which covers clones running 50% slow.
+    uint32_t limit = 2 * HD44780_nominal_execution_time(exec_class);
+    uint32_t measured = elapsed < limit ? elapsed + waited : limit;
+    uint32_t target = measured + measured / 256;
+    uint32_t raise = estimate + estimate / 8;
+
+    target = target < raise ? target : raise;
+
+    if (target > estimate)
+    {
+        lcd->state.exec_estimate[exec_class] = target < limit ? target : limit;
+    }
+}
+
+static inline void HD44780_set_pending(HD44780 *lcd, bool rs, uint8_t byte)
+{
+    lcd->state.exec_class = HD44780_exec_class(rs, byte);
+    lcd->state.exec_tick = HAL_GetTick();
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    lcd->state.exec_cycles = HD44780_CYCLES();
+#endif
+    lcd->state.exec_pending = true;
+}
+
+static inline uint32_t HD44780_pending_elapsed(HD44780 *lcd, bool *exact)
+{
+    // A difference of n ticks only guarantees that more than n - 1 ms elapsed. Beyond 4ms, longer than any estimate,
+    // the exact time does not matter.
+    uint32_t ticks = HAL_GetTick() - lcd->state.exec_tick;
+    uint32_t elapsed_ms = ticks ? ticks - 1 : 0;
+    uint32_t elapsed = (elapsed_ms < 4 ? elapsed_ms : 4) * 1000000;
+
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    uint32_t cycles = HD44780_CYCLES() - lcd->state.exec_cycles;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+    // The tick count covers the operations older than a period of the cycle counter, and the cores clocked below 1MHz.
+    if (cycles_per_us && cycles / cycles_per_us < 4000)
+    {
+        uint32_t measured = cycles * 1000 / cycles_per_us;
+        elapsed = measured > elapsed ? measured : elapsed;
+    }
+
+    *exact = true;
+#else
+    *exact = false;
+#endif
+
+    return elapsed;
+}
+
+static inline void HD44780_await_execution(HD44780 *lcd, bool rs, uint8_t byte)
+{
+    if (lcd->transport)
+    {
+        // The transport already spaced the operation by its execution time.
+        return;
+    }
+
+    if (lcd->write_only)
+    {
+        delay_ns(HD44780_execution_time(rs, byte));
+    }
+    else
+    {
+        HD44780_await_busyflag(lcd, HD44780_exec_class(rs, byte), 0, true);
+    }
+}
+
+static bool HD44780_fb_next(HD44780 *lcd, HD44780_FbIterator *it, bool *rs, uint8_t *byte)
+{
+    // Buffered characters are always sent left to right, without shifting the display.
+    uint8_t flush_entry_mode = HD44780_CMD_ENTRY_MODE_SET | HD44780_FLG_DISPLAY_NOSHIFT | HD44780_FLG_DIR_LTR;
+
+    if (it->index < it->run_end)
+    {
+        *rs = true;
+        *byte = lcd->framebuffer[it->index++];
+        return true;
+    }
+
+    while (it->index < HD44780_DDRAM_SIZE && !HD44780_fb_is_dirty(lcd, it->index))
+    {
+        ++it->index;
+    }
+
+    *rs = false;
+
+    if (it->index < HD44780_DDRAM_SIZE)
+    {
+        if (!it->entry_mode_changed && lcd->state.entry_mode != flush_entry_mode)
+        {
+            it->entry_mode_changed = true;
+            *byte = flush_entry_mode;
+            return true;
+        }
+
+        // Rewriting a single clean cell costs the same as a set address instruction, so merge runs separated by one
+        // clean cell. In two lines mode the address counter jumps from 0x27 to 0x40, so runs can span both lines.
+        uint8_t end = it->index + 1;
+
+        while (end < HD44780_DDRAM_SIZE &&
+               (HD44780_fb_is_dirty(lcd, end) || (end + 1 < HD44780_DDRAM_SIZE && HD44780_fb_is_dirty(lcd, end + 1))))
+        {
+            ++end;
+        }
+
+        it->run_end = end;
+        it->moved = true;
+        *byte = HD44780_CMD_SET_DDRAM_ADDRESS | HD44780_fb_address(lcd, it->index);
+        return true;
+    }
+
+    if (it->entry_mode_changed)
+    {
+        it->entry_mode_changed = false;
+        *byte = lcd->state.entry_mode;
+        return true;
+    }
+
+    if (it->moved)
+    {
+        it->moved = false;
+        *byte = HD44780_CMD_SET_DDRAM_ADDRESS | HD44780_fb_address(lcd, lcd->state.fb_cursor);
+        return true;
+    }
+
+    return false;
+}
+
+static void HD44780_fb_sync(HD44780 *lcd, HD44780_Sink sink, void *context)
+{
+    HD44780_FbIterator it = {0};
+    bool rs;
+    uint8_t byte;
+
+    while (HD44780_fb_next(lcd, &it, &rs, &byte))
+    {
+        sink(lcd, context, rs, byte);
+    }
+}
+
+static void HD44780_run_sink(HD44780 *lcd, void *context, bool rs, uint8_t byte)
+{
+    HD44780_Writer *run = context;
+
+    if (rs)
+    {
+        run->buf[run->len++] = byte;
+
+        if (run->len < sizeof(run->buf))
+        {
+            return;
+        }
+    }
+
+    HD44780_send_data(lcd, run->buf, run->len);
+    run->len = 0;
+
+    if (!rs)
+    {
+        HD44780_write_byte(lcd, false, byte);
+    }
+}
+
+static inline uint8_t HD44780_ddram_address(HD44780 *lcd, uint8_t column, uint8_t row)
+{
+    return lcd->state.row_offsets[row % lcd->state.row_count] + lcd->state.page_offset + column;
+}
+
+static char *HD44780_format_number(char *end,
+                                   unsigned long value,
+                                   bool negative,
+                                   uint8_t base,
+                                   bool upper,
+                                   uint8_t decimals)
+{
+    char *p = end;
+    uint8_t digits = 0;
+
+    // At least one digit before the decimal point.
+    do
+    {
+        if (decimals && digits == decimals)
+        {
+            *--p = '.';
+        }
+
+        uint8_t digit = value % base;
+        *--p = digit < 10 ? '0' + digit : (upper ? 'A' : 'a') + digit - 10;
+        value /= base;
+        digits++;
+    } while (value || digits <= decimals);
+
+    if (negative)
+    {
+        *--p = '-';
+    }
+
+    return p;
+}
+
+static void HD44780_writer_put(HD44780_Writer *writer, char chr)
+{
+    writer->buf[writer->len++] = chr;
+
+    if (writer->len == sizeof(writer->buf))
+    {
+        HD44780_writer_flush(writer);
+    }
+}
+
+static void HD44780_writer_fill(HD44780_Writer *writer, char chr, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        HD44780_writer_put(writer, chr);
+    }
+}
+
+static void HD44780_writer_flush(HD44780_Writer *writer)
+{
+    HD44780_write_buf(writer->lcd, writer->buf, writer->len);
+    writer->len = 0;
+}
+
+static void HD44780_bar_symbol(bool vertical, uint8_t fill, uint8_t symbol[10])
+{
+    for (uint8_t row = 0; row < 10; ++row)
+    {
+        if (vertical)
+        {
+            // Filled from the bottom row of the 5x8 cell.
+            symbol[row] = row >= HD44780_BAR_V_LEVELS - fill && row < HD44780_BAR_V_LEVELS ? 0x1F : 0x00;
+        }
+        else
+        {
+            // Filled from the leftmost column, the most significant of the 5 bits.
+            symbol[row] = 0x1F & ~(0x1F >> fill);
+        }
+    }
+}
+
+static uint8_t HD44780_bar_cell(HD44780 *lcd, const HD44780_Bar *bar, uint8_t cell, uint16_t level)
+{
+    uint8_t levels = bar->vertical ? HD44780_BAR_V_LEVELS : HD44780_BAR_H_LEVELS;
+    uint16_t start = cell * levels;
+
+    if (level >= start + levels)
+    {
+        return HD44780_FULL_BLOCK;
+    }
+
+    if (level <= start)
+    {
+        return ' ';
+    }
+
+    // The symbol was loaded by HD44780_bar_init(), the lookup only reloads it when it has been replaced since.
+    uint8_t symbol[10];
+    HD44780_bar_symbol(bar->vertical, level - start, symbol);
+    return HD44780_glyph(lcd, symbol);
+}
+
+static inline uint8_t HD44780_shift_length(HD44780 *lcd)
+{
+    return lcd->single_line ? HD44780_DDRAM_SIZE : HD44780_LINE_LENGTH;
+}
+
+static inline void HD44780_step_shift(HD44780 *lcd, bool left)
+{
+    uint8_t length = HD44780_shift_length(lcd);
+    lcd->state.display_shift = (lcd->state.display_shift + (left ? 1 : length - 1)) % length;
+}
+
+static inline uint8_t HD44780_page_width(HD44780 *lcd)
+{
+    if (!lcd->columns)
+    {
+        return HD44780_shift_length(lcd);
+    }
+
+    uint8_t rows = lcd->single_line ? lcd->state.row_count : (lcd->state.row_count + 1) / 2;
+    return rows * lcd->columns;
+}
+
+static inline uint8_t HD44780_line_address(HD44780 *lcd, uint8_t row, uint8_t column)
+{
+    uint8_t start = lcd->state.row_offsets[row % lcd->state.row_count];
+    uint8_t line = lcd->single_line ? 0 : start & HD44780_SECOND_LINE_ADDRESS;
+    return line + (start - line + column) % HD44780_shift_length(lcd);
+}
+
+static void HD44780_address_to(HD44780 *lcd, uint8_t address)
+{
+    if (lcd->framebuffer)
+    {
+        lcd->state.fb_cursor = HD44780_fb_index(lcd, address);
+        return;
+    }
+
+    if (!lcd->state.address_cgram && lcd->state.address == address)
+    {
+        return;
+    }
+
+    HD44780_write_instruction(lcd, HD44780_CMD_SET_DDRAM_ADDRESS | address);
+}
+
+static void HD44780_ticker_load(HD44780 *lcd, HD44780_Ticker *ticker, uint32_t end)
+{
+    uint8_t length = HD44780_shift_length(lcd);
+
+    while (ticker->loaded < end)
+    {
+        uint8_t address = HD44780_line_address(lcd, ticker->row, ticker->loaded % length);
+        uint8_t column = lcd->single_line ? address : address & ~HD44780_SECOND_LINE_ADDRESS;
+        size_t offset = ticker->loaded % ticker->length;
+
+        // Runs stop at the end of the DDRAM line, where the address counter does not wrap to the line start, and at
+        // the end of the text.
+        size_t n = end - ticker->loaded;
+        n = n < (size_t)(length - column) ? n : (size_t)(length - column);
+        n = n < ticker->length - offset ? n : ticker->length - offset;
+
+        HD44780_address_to(lcd, address);
+        HD44780_write_span(lcd, (const uint8_t *)ticker->text + offset, n);
+        ticker->loaded += n;
+    }
+}
+
+static void HD44780_write_cgram(HD44780 *lcd, uint8_t address, const uint8_t *rows, uint8_t len)
+{
+    // The address counter is moved back to its position, in DDRAM or CGRAM.
+    uint8_t restore = HD44780_address_instruction(lcd);
+
+    HD44780_write_instruction(lcd, HD44780_CMD_SET_CGRAM_ADDRESS | (address % HD44780_CGRAM_SIZE));
+
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        HD44780_write_data(lcd, rows[i]);
+        lcd->state.cgram[(address + i) % HD44780_CGRAM_SIZE] = rows[i];
+    }
+
+    HD44780_write_instruction(lcd, restore);
+}
+
+static inline uint16_t HD44780_slot_hash(const uint8_t *rows)
 {
-    HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_SET);
+    uint16_t hash = 0;
 
-    // Data delay time = 360ns
-    // Enable rise/fall time = 25ns
-    // Total = 385ns
-    delay_ns(400);
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        hash = hash * 31 + rows[i];
+    }
 
-    uint8_t value = 0;
+    return hash;
+}
 
-    if (lcd->interface_8_bit)
+static uint8_t HD44780_visible_glyphs(HD44780 *lcd)
+{
+    if (!lcd->framebuffer)
     {
-        value |= HAL_GPIO_ReadPin(lcd->d7_gpio, lcd->d7_pin) << 7;
-        value |= HAL_GPIO_ReadPin(lcd->d6_gpio, lcd->d6_pin) << 6;
-        value |= HAL_GPIO_ReadPin(lcd->d5_gpio, lcd->d5_pin) << 5;
-        value |= HAL_GPIO_ReadPin(lcd->d4_gpio, lcd->d4_pin) << 4;
-        value |= HAL_GPIO_ReadPin(lcd->d3_gpio, lcd->d3_pin) << 3;
-        value |= HAL_GPIO_ReadPin(lcd->d2_gpio, lcd->d2_pin) << 2;
-        value |= HAL_GPIO_ReadPin(lcd->d1_gpio, lcd->d1_pin) << 1;
-        value |= HAL_GPIO_ReadPin(lcd->d0_gpio, lcd->d0_pin) << 0;
+        return 0;
+    }
+
+    uint8_t width = HD44780_row_width(lcd);
+    uint8_t visible = 0;
+
+    // The page being composed is kept as well, it is about to be displayed.
+    uint8_t origins[] = {lcd->state.display_shift, lcd->state.page_offset};
+
+    for (uint8_t i = 0; i < sizeof(origins); ++i)
+    {
+        for (uint8_t row = 0; row < lcd->state.row_count; ++row)
+        {
+            for (uint8_t column = 0; column < width; ++column)
+            {
+                uint8_t address = HD44780_line_address(lcd, row, origins[i] + column);
+                uint8_t chr = lcd->framebuffer[HD44780_fb_index(lcd, address)];
+
+                // Character codes 0x08 to 0x0F display the same symbols as 0x00 to 0x07.
+                if (chr < 0x10)
+                {
+                    visible |= 1 << (chr % 8);
+                }
+            }
+        }
+    }
+
+    return visible;
+}
+
+static inline HD44780_ExecClass HD44780_exec_class(bool rs, uint8_t byte)
+{
+    if (rs)
+    {
+        return HD44780_EXEC_DATA;
+    }
+
+    if (byte == HD44780_CMD_CLEAR_DISPLAY || (byte & ~1) == HD44780_CMD_RETURN_HOME)
+    {
+        return HD44780_EXEC_LONG;
+    }
+
+    return HD44780_EXEC_SHORT;
+}
+
+static inline uint32_t HD44780_nominal_execution_time(HD44780_ExecClass exec_class)
+{
+    return exec_class == HD44780_EXEC_LONG ? HD44780_T_EXEC_LONG : HD44780_T_EXEC;
+}
+
+static inline uint32_t HD44780_execution_time(bool rs, uint8_t byte)
+{
+    uint32_t time = HD44780_nominal_execution_time(HD44780_exec_class(rs, byte));
+
+    return time + time / 100 * HD44780_TIMING_MARGIN;
+}
+
+static inline bool HD44780_wave_supported(HD44780 *lcd)
+{
+    return !lcd->transport && lcd->state.data_port_count == 1 &&
+           lcd->state.data_ports[0].gpio == lcd->rs_gpio && lcd->state.data_ports[0].gpio == lcd->en_gpio;
+}
+
+static inline void HD44780_wave_push(HD44780_Waveform *wave, uint32_t word, uint32_t idle)
+{
+    for (uint32_t i = 0; i <= idle; ++i)
+    {
+        if (wave->count < wave->capacity)
+        {
+            wave->words[wave->count] = i ? 0 : word;
+        }
+
+        wave->count++;
+    }
+}
+
+static inline uint32_t HD44780_wave_ticks(const HD44780_Waveform *wave, uint32_t ns)
+{
+    uint32_t ticks = (ns + wave->tick_ns - 1) / wave->tick_ns;
+    return ticks ? ticks : 1;
+}
+
+static void HD44780_wave_value(HD44780 *lcd, HD44780_Waveform *wave, bool rs, uint8_t value)
+{
+    const HD44780_DataPort *port = &lcd->state.data_ports[0];
+
+    uint32_t set = lcd->interface_8_bit ? port->set_high[(value >> 4) & 0x0F] | port->set_low[value & 0x0F]
+                                        : port->set_high[value & 0x0F];
+    uint32_t reset = port->pins & ~set;
+
+    if (rs)
+    {
+        set |= lcd->rs_pin;
     }
     else
     {
-        value |= HAL_GPIO_ReadPin(lcd->d7_gpio, lcd->d7_pin) << 3;
-        value |= HAL_GPIO_ReadPin(lcd->d6_gpio, lcd->d6_pin) << 2;
-        value |= HAL_GPIO_ReadPin(lcd->d5_gpio, lcd->d5_pin) << 1;
-        value |= HAL_GPIO_ReadPin(lcd->d4_gpio, lcd->d4_pin) << 0;
+        reset |= lcd->rs_pin;
     }
 
-    HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_RESET);
+    uint32_t setup = HD44780_wave_ticks(wave, HD44780_T_ADDRESS_SETUP);
+    uint32_t high = HD44780_wave_ticks(wave, HD44780_T_ENABLE_WRITE);
+    uint32_t cycle = HD44780_wave_ticks(wave, HD44780_T_ENABLE_CYCLE);
 
-    return value;
+    // RS and data first, then the EN pulse. The data is latched on the falling edge of EN.
+    HD44780_wave_push(wave, set | reset << 16, setup - 1);
+    HD44780_wave_push(wave, lcd->en_pin, high - 1);
+    HD44780_wave_push(wave, (uint32_t)lcd->en_pin << 16, cycle > setup + high + 1 ? cycle - setup - high - 1 : 0);
 }
 
-static void HD44780_push_value(const HD44780 *lcd, uint8_t byte)
+static void HD44780_wave_sink(HD44780 *lcd, void *context, bool rs, uint8_t byte)
 {
-    HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_SET);
+    HD44780_Waveform *wave = context;
+
+    HD44780_track_address(lcd, rs, byte);
 
     if (lcd->interface_8_bit)
     {
-        HAL_GPIO_WritePin(lcd->d7_gpio, lcd->d7_pin, byte & (1 << 7) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d6_gpio, lcd->d6_pin, byte & (1 << 6) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d5_gpio, lcd->d5_pin, byte & (1 << 5) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d4_gpio, lcd->d4_pin, byte & (1 << 4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d3_gpio, lcd->d3_pin, byte & (1 << 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d2_gpio, lcd->d2_pin, byte & (1 << 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d1_gpio, lcd->d1_pin, byte & (1 << 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d0_gpio, lcd->d0_pin, byte & (1 << 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HD44780_wave_value(lcd, wave, rs, byte);
     }
     else
     {
-        HAL_GPIO_WritePin(lcd->d7_gpio, lcd->d7_pin, byte & (1 << 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d6_gpio, lcd->d6_pin, byte & (1 << 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d5_gpio, lcd->d5_pin, byte & (1 << 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(lcd->d4_gpio, lcd->d4_pin, byte & (1 << 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        HD44780_wave_value(lcd, wave, rs, byte >> 4);
+        HD44780_wave_value(lcd, wave, rs, byte);
     }
 
-    // Data set-up time = 195ns
-    // Enable rise/fall time = 25ns
-    // Total = 220ns
-    delay_ns(240);
+    // The busy flag cannot be checked, wait for the execution time.
+    uint32_t idle = HD44780_wave_ticks(wave, HD44780_execution_time(rs, byte));
+    HD44780_wave_push(wave, 0, idle - 1);
+}
 
-    HAL_GPIO_WritePin(lcd->en_gpio, lcd->en_pin, GPIO_PIN_RESET);
+static void HD44780_track_address(HD44780 *lcd, bool rs, uint8_t byte)
+{
+    HD44780_State *state = &lcd->state;
 
-    // Address hold time = 20ns
+    if (rs)
+    {
+        if (state->shift_on_write && !state->address_cgram)
+        {
+            HD44780_step_shift(lcd, state->address_increment);
+        }
+
+        HD44780_step_address(lcd, state->address_increment);
+    }
+    else if (byte & HD44780_CMD_SET_DDRAM_ADDRESS)
+    {
+        state->address = byte & 0x7F;
+        state->address_cgram = false;
+    }
+    else if (byte & HD44780_CMD_SET_CGRAM_ADDRESS)
+    {
+        state->address = byte & 0x3F;
+        state->address_cgram = true;
+    }
+    else if (byte & HD44780_CMD_FUNCTION_SET)
+    {
+        // No effect on the address counter.
+    }
+    else if (byte & HD44780_CMD_CURSOR_DISPLAY_SHIFT)
+    {
+        if (byte & HD44780_FLG_SHIFT_DISPLAY)
+        {
+            HD44780_step_shift(lcd, !(byte & HD44780_FLG_SHIFT_RTL));
+        }
+        else
+        {
+            HD44780_step_address(lcd, !(byte & HD44780_FLG_SHIFT_RTL));
+        }
+    }
+    else if (byte & HD44780_CMD_DISPLAY_CONTROL)
+    {
+        // No effect on the address counter.
+    }
+    else if (byte & HD44780_CMD_ENTRY_MODE_SET)
+    {
+        state->address_increment = byte & HD44780_FLG_DIR_LTR;
+        state->shift_on_write = byte & HD44780_FLG_DISPLAY_SHIFT;
+    }
+    else if (byte & HD44780_CMD_RETURN_HOME)
+    {
+        state->address = 0;
+        state->address_cgram = false;
+        state->display_shift = 0;
+    }
+    else if (byte & HD44780_CMD_CLEAR_DISPLAY)
+    {
+        // Clear display also sets I/D to 1 in the entry mode.
+        state->address = 0;
+        state->address_cgram = false;
+        state->address_increment = true;
+        state->display_shift = 0;
+    }
 }
 
-static uint8_t HD44780_read_byte(const HD44780 *lcd)
+static inline void HD44780_step_address(HD44780 *lcd, bool increment)
 {
-    HAL_GPIO_WritePin(lcd->rw_gpio, lcd->rw_pin, GPIO_PIN_SET);
-    HAL_GPIO_WritePin(lcd->rs_gpio, lcd->rs_pin, GPIO_PIN_RESET);
-
-    // Address set-up time (RS, R/W to E) = 60ns
+    HD44780_State *state = &lcd->state;
 
-    HD44780_set_data_mode(lcd, GPIO_MODE_INPUT);
+    if (state->address_cgram)
+    {
+        state->address = (state->address + (increment ? 1 : -1)) & 0x3F;
+        return;
+    }
 
-    uint8_t byte = 0;
+    // The framebuffer index space wraps around like the address counter, from the last to the first position.
+    uint8_t index = HD44780_fb_index(lcd, state->address);
 
-    if (lcd->interface_8_bit)
+    if (increment)
     {
-        byte = HD44780_pull_value(lcd);
+        index = index + 1 < HD44780_DDRAM_SIZE ? index + 1 : 0;
     }
     else
     {
-        byte |= HD44780_pull_value(lcd) << 4;
-        byte |= HD44780_pull_value(lcd);
+        index = index ? index - 1 : HD44780_DDRAM_SIZE - 1;
     }
 
-    return byte;
+    state->address = HD44780_fb_address(lcd, index);
 }
 
-static void HD44780_write_byte(const HD44780 *lcd, bool rs, uint8_t byte)
+static inline HD44780_Tracked HD44780_save_tracked(HD44780 *lcd)
 {
-    HD44780_set_data_mode(lcd, GPIO_MODE_OUTPUT_PP);
+    const HD44780_State *state = &lcd->state;
 
-    HAL_GPIO_WritePin(lcd->rw_gpio, lcd->rw_pin, GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(lcd->rs_gpio, lcd->rs_pin, rs);
+    return (HD44780_Tracked){
+        .address = state->address,
+        .address_cgram = state->address_cgram,
+        .address_increment = state->address_increment,
+        .shift_on_write = state->shift_on_write,
+        .display_shift = state->display_shift,
+    };
+}
 
-    // Address set-up time (RS, R/W to E) = 60ns
+static inline void HD44780_restore_tracked(HD44780 *lcd, const HD44780_Tracked *tracked)
+{
+    HD44780_State *state = &lcd->state;
 
-    if (lcd->interface_8_bit)
+    state->address = tracked->address;
+    state->address_cgram = tracked->address_cgram;
+    state->address_increment = tracked->address_increment;
+    state->shift_on_write = tracked->shift_on_write;
+    state->display_shift = tracked->display_shift;
+}
+
+static inline bool *HD44780_data_input(HD44780 *lcd)
+{
+    return lcd->bus ? &lcd->bus->data_input : &lcd->state.data_input;
+}
+
+static inline volatile bool *HD44780_bus_lock(HD44780 *lcd)
+{
+    return lcd->bus ? &lcd->bus->locked : &lcd->state.bus_locked;
+}
+
+static inline void HD44780_set_enable(HD44780 *lcd, bool high)
+{
+    if (!lcd->bus || !lcd->bus->broadcast)
     {
-        HD44780_push_value(lcd, byte);
+        if (high)
+        {
+            GPIO_set(lcd->en_gpio, lcd->en_pin);
+        }
+        else
+        {
+            GPIO_reset(lcd->en_gpio, lcd->en_pin);
+        }
+
+        return;
     }
-    else
+
+    for (uint8_t i = 0; i < lcd->bus->controller_count; ++i)
     {
-        HD44780_push_value(lcd, byte >> 4);
-        HD44780_push_value(lcd, byte);
+        HD44780 *controller = lcd->bus->controllers[i];
+
+        if (high)
+        {
+            GPIO_set(controller->en_gpio, controller->en_pin);
+        }
+        else
+        {
+            GPIO_reset(controller->en_gpio, controller->en_pin);
+        }
+    }
+}
+
+static bool HD44780_is_idle(HD44780 *lcd)
+{
+    if (!lcd->state.exec_pending)
+    {
+        return true;
     }
 
-    HD44780_await_busyflag(lcd);
+    volatile bool *locked = HD44780_bus_lock(lcd);
+    bool was_locked = *locked;
+    *locked = true;
 
-    // After execution of the CGRAM/DDRAM data write or read instruction,
-    // the RAM address counter is incremented or decremented by 1.
-    // The RAM address counter is updated after the busy flag turns off.
-    // Address counter update time = 4us
-    if (rs)
+    bool busy = HD44780_get_busyflag(lcd);
+
+    *locked = was_locked;
+
+    if (!busy)
     {
-        delay_us(5);
+        lcd->state.exec_pending = false;
     }
+
+    return !busy;
 }
 
-static void HD44780_write_init(const HD44780 *lcd, uint8_t byte)
+static inline void HD44780_await_pending(HD44780 *lcd)
 {
-    if (lcd->interface_8_bit)
+    if (!lcd->state.exec_pending)
     {
-        HD44780_push_value(lcd, byte);
+        return;
     }
-    else
+
+    volatile bool *locked = HD44780_bus_lock(lcd);
+    bool was_locked = *locked;
+    *locked = true;
+
+    bool exact;
+    uint32_t elapsed = HD44780_pending_elapsed(lcd, &exact);
+
+    HD44780_await_busyflag(lcd, lcd->state.exec_class, elapsed, exact);
+    lcd->state.exec_pending = false;
+
+    *locked = was_locked;
+}
+
+static void HD44780_drain(HD44780 *lcd)
+{
+    while (HD44780_queue_depth(lcd) || lcd->state.init_step != HD44780_INIT_DONE)
     {
-        HD44780_push_value(lcd, byte >> 4);
+        if (HD44780_is_queued(lcd))
+        {
+            HD44780_poll(lcd);
+        }
+        else
+        {
+            HD44780_await_pending(lcd);
+        }
+    }
+}
+
+static void HD44780_broadcast_instruction(HD44780_Bus *bus, uint8_t byte)
+{
+    if (!bus->controller_count)
+    {
+        return;
+    }
+
+    // Every controller must be idle before the shared lines are used to pulse all the EN lines.
+    for (uint8_t i = 0; i < bus->controller_count; ++i)
+    {
+        HD44780_drain(bus->controllers[i]);
+    }
+
+    bus->locked = true;
+
+    bus->broadcast = true;
+    HD44780_transmit_byte(bus->controllers[0], false, byte);
+    bus->broadcast = false;
+
+    bool timed = false;
+
+    for (uint8_t i = 0; i < bus->controller_count; ++i)
+    {
+        HD44780 *lcd = bus->controllers[i];
+
+        // The other controllers received the instruction along with the first one, which counted the transfer.
+        if (i)
+        {
+            HD44780_STAT(lcd, instructions, 1);
+            HD44780_STAT(lcd, en_pulses, lcd->interface_8_bit ? 1 : 2);
+        }
+
+        HD44780_track_address(lcd, false, byte);
+
+        if (lcd->write_only)
+        {
+            timed = true;
+        }
+        else
+        {
+            HD44780_set_pending(lcd, false, byte);
+        }
+    }
+
+    // The controllers execute the instruction in parallel, a single wait covers all the write only ones.
+    if (timed)
+    {
+        delay_ns(HD44780_execution_time(false, byte));
     }
+
+    bus->locked = false;
 }
 
-static inline uint8_t HD44780_get_address(const HD44780 *lcd)
+static void HD44780_config_instructions(const HD44780_Config *config, uint8_t *entry_mode, uint8_t *display_control)
 {
-    return HD44780_read_byte(lcd) & ~(1 << HD44780_CMD_READ_BUSYFLAG_AND_ADDRESS);
+    uint8_t flg_display_en = config->disable_display ? HD44780_FLG_DISPLAY_OFF : HD44780_FLG_DISPLAY_ON;
+    uint8_t flg_cursor_en = config->enable_cursor ? HD44780_FLG_CURSOR_ON : HD44780_FLG_CURSOR_OFF;
+    uint8_t flg_blink_en = config->enable_blink ? HD44780_FLG_BLINK_ON : HD44780_FLG_BLINK_OFF;
+    uint8_t flg_shift_entity = config->shift_display ? HD44780_FLG_DISPLAY_SHIFT : HD44780_FLG_DISPLAY_NOSHIFT;
+    uint8_t flg_shift_dir = config->shift_rtl ? HD44780_FLG_DIR_RTL : HD44780_FLG_DIR_LTR;
+
+    *entry_mode = HD44780_CMD_ENTRY_MODE_SET | flg_shift_entity | flg_shift_dir;
+    *display_control = HD44780_CMD_DISPLAY_CONTROL | flg_display_en | flg_cursor_en | flg_blink_en;
 }
 
-static inline uint8_t HD44780_get_busyflag(const HD44780 *lcd)
+#if defined(HAL_I2C_MODULE_ENABLED)
+
+static void HD44780_pcf8574_init(HD44780 *lcd)
 {
-    return HD44780_read_byte(lcd) >> HD44780_CMD_READ_BUSYFLAG_AND_ADDRESS & 1;
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+
+    pcf->count = 0;
+    HD44780_pcf8574_push(pcf, pcf->backlight ? HD44780_PCF8574_BACKLIGHT : 0);
+    HD44780_pcf8574_transmit(pcf);
+    HD44780_pcf8574_await(pcf);
 }
 
-static inline void HD44780_write_instruction(const HD44780 *lcd, uint8_t byte)
+static void HD44780_pcf8574_write(HD44780 *lcd, bool rs, const uint8_t *data, size_t len)
 {
-    HD44780_write_byte(lcd, 0, byte);
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+    uint8_t control = (rs ? HD44780_PCF8574_RS : 0) | (pcf->backlight ? HD44780_PCF8574_BACKLIGHT : 0);
+
+    // [ns] The outputs change once per frame, rounding down only adds idle frames.
+    uint32_t clock_hz = pcf->clock_hz ? pcf->clock_hz : HD44780_PCF8574_DEFAULT_CLOCK;
+    uint32_t frame_ns = (uint64_t)HD44780_PCF8574_FRAME_CLOCKS * 1000000000 / clock_hz;
+    uint32_t idle = 0;
+
+    // RS is set up one frame before the first rising edge of EN.
+    HD44780_pcf8574_push(pcf, control);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (; idle; --idle)
+        {
+            HD44780_pcf8574_push(pcf, control);
+        }
+
+        HD44780_pcf8574_nibble(pcf, (data[i] & 0xF0) | control);
+        HD44780_pcf8574_nibble(pcf, (uint8_t)(data[i] << 4) | control);
+
+        uint32_t time = HD44780_execution_time(rs, data[i]);
+
+        // Idle frames would fill the buffer several times over, the long instructions are waited with the CPU.
+        if (HD44780_exec_class(rs, data[i]) == HD44780_EXEC_LONG)
+        {
+            HD44780_pcf8574_transmit(pcf);
+            HD44780_pcf8574_await(pcf);
+            delay_ns(time);
+            continue;
+        }
+
+        // The next rising edge of EN comes one frame after the falling edge, the idle frames cover the rest.
+        idle = (time + frame_ns - 1) / frame_ns - 1;
+    }
+
+    // The next transaction starts with the address and the RS set-up frame, which cover two of the idle frames.
+    for (; idle > 2; --idle)
+    {
+        HD44780_pcf8574_push(pcf, control);
+    }
+
+    HD44780_pcf8574_transmit(pcf);
 }
 
-static inline void HD44780_write_data(const HD44780 *lcd, uint8_t byte)
+static void HD44780_pcf8574_write_init(HD44780 *lcd, uint8_t byte)
 {
-    HD44780_write_byte(lcd, 1, byte);
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+    uint8_t control = pcf->backlight ? HD44780_PCF8574_BACKLIGHT : 0;
+
+    HD44780_pcf8574_push(pcf, control);
+    HD44780_pcf8574_nibble(pcf, (byte & 0xF0) | control);
+    HD44780_pcf8574_transmit(pcf);
+    HD44780_pcf8574_await(pcf);
+}
+
+static void HD44780_pcf8574_push(HD44780_PCF8574 *pcf, uint8_t frame)
+{
+    // The DMA channel may still be reading the buffer.
+    if (!pcf->count)
+    {
+        HD44780_pcf8574_await(pcf);
+    }
+
+    pcf->frames[pcf->count++] = frame;
+
+    if (pcf->count == HD44780_PCF8574_FRAMES)
+    {
+        HD44780_pcf8574_transmit(pcf);
+    }
+}
+
+static inline void HD44780_pcf8574_nibble(HD44780_PCF8574 *pcf, uint8_t frame)
+{
+    HD44780_pcf8574_push(pcf, frame | HD44780_PCF8574_EN);
+    HD44780_pcf8574_push(pcf, frame);
 }
 
-static inline uint8_t HD44780_get_current_line(const HD44780 *lcd)
+static void HD44780_pcf8574_transmit(HD44780_PCF8574 *pcf)
 {
-    uint8_t address = HD44780_get_address(lcd);
-    return !lcd->single_line && address >= HD44780_SECOND_LINE_ADDRESS;
+    if (!pcf->count)
+    {
+        return;
+    }
+
+    // Errors are not reported, as with the GPIO interface the controller state cannot be checked.
+    if (pcf->dma)
+    {
+        HAL_I2C_Master_Transmit_DMA(pcf->hi2c, pcf->address, pcf->frames, pcf->count);
+    }
+    else
+    {
+        HAL_I2C_Master_Transmit(pcf->hi2c, pcf->address, pcf->frames, pcf->count, HAL_MAX_DELAY);
+    }
+
+    pcf->count = 0;
 }
 
-static inline void HD44780_await_busyflag(const HD44780 *lcd)
+static inline void HD44780_pcf8574_await(HD44780_PCF8574 *pcf)
 {
-    while (HD44780_get_busyflag(lcd))
+    while (pcf->dma && HAL_I2C_GetState(pcf->hi2c) != HAL_I2C_STATE_READY)
         ;
 }
+
+#endif
@@ -12,6 +12,7 @@
 #ifndef __HD44780_H__
 #define __HD44780_H__
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
@@ -55,12 +56,304 @@
 #error No MPU architecture selected.
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HD44780_GPIO_WRITE
+/**
+ * Store a value to a GPIO peripheral register.
+ * Can be overridden to redirect the register accesses, e.g. to the host simulator.
+ */
+#define HD44780_GPIO_WRITE(gpio, reg, value) ((gpio)->reg = (value))
+#endif
+
+#ifndef HD44780_GPIO_READ
+/**
+ * Load the value of a GPIO peripheral register.
+ * Can be overridden to redirect the register accesses, e.g. to the host simulator.
+ */
+#define HD44780_GPIO_READ(gpio, reg) ((gpio)->reg)
+#endif
+
+#ifndef HD44780_CYCLES
+/**
+ * Read a free running counter of CPU cycles, used for the timings of @ref HD44780::stats when HD44780_STATS is
+ * defined, and for the age of the operations left executing by the instances on a @ref HD44780_Bus on cores with the
+ * DWT. Defaults to the DWT cycle counter started by HD44780_init(). Must be overridden on Cortex-M0 and M0+ devices,
+ * which have no cycle counter, e.g. with a free running timer, for the statistics only.
+ */
+#define HD44780_CYCLES() (DWT->CYCCNT)
+#endif
+
+/**
+ * Size in bytes of the controller display data RAM (DDRAM).
+ * Buffers used with the @ref HD44780::framebuffer option must be at least this big.
+ */
+#define HD44780_DDRAM_SIZE 80
+
+/**
+ * Size in bytes of the controller character generator RAM (CGRAM), 8 rows for each of the 8 user defined symbols.
+ */
+#define HD44780_CGRAM_SIZE 64
+
+/**
+ * Maximum number of visible rows of a display driven by a single controller, see @ref HD44780::rows.
+ */
+#define HD44780_MAX_ROWS 4
+
+#ifndef HD44780_MAX_DATA_PORTS
+/**
+ * Maximum number of GPIO ports the data lines can be spread across while still being written with a single register
+ * store per port. When the data lines use more ports, the library falls back to writing each pin separately.
+ */
+#define HD44780_MAX_DATA_PORTS 2
+#endif
+
+#ifndef HD44780_QUEUE_SIZE
+/**
+ * Number of instructions and data bytes that can be waiting in the queue of an instance in asynchronous mode.
+ */
+#define HD44780_QUEUE_SIZE 32
+#endif
+
+#ifndef HD44780_TIMING_MARGIN
+/**
+ * [%] Margin added to the datasheet execution times when the busy flag cannot be read (@ref HD44780::write_only mode
+ * and waveforms), covering the controller oscillator tolerance. Clones running 50% slow need a margin of at least 50.
+ */
+#define HD44780_TIMING_MARGIN 25
+#endif
+
+#ifndef HD44780_FIELD_WIDTH
+/**
+ * Maximum number of characters of a @ref HD44780_Field.
+ */
+#define HD44780_FIELD_WIDTH 12
+#endif
+
+#ifndef HD44780_PCF8574_FRAMES
+/**
+ * Number of expander output values buffered by a @ref HD44780_PCF8574 backpack before they are transmitted, larger
+ * writes are split into several I2C transactions.
+ */
+#define HD44780_PCF8574_FRAMES 128
+#endif
+
+#ifndef HD44780_MAX_BUS_CONTROLLERS
+/**
+ * Maximum number of controllers that can share a @ref HD44780_Bus.
+ */
+#define HD44780_MAX_BUS_CONTROLLERS 4
+#endif
+
+/**
+ * Data lines connected to the same GPIO port, with the lookup tables used to update them with a single register store.
+ */
+typedef struct
+{
+    /** GPIO port of the data lines. */
+    GPIO_TypeDef *gpio;
+
+    /** Mask of all the data line pins belonging to this port. */
+    uint16_t pins;
+
+    /** Pin mask of each data line (DB0 to DB7) when it belongs to this port, 0 otherwise. */
+    uint16_t line_pins[8];
+
+    /** Pins to set for each value of the low nibble (DB3 to DB0), all the other data pins of the port are reset. */
+    uint16_t set_low[16];
+
+    /** Pins to set for each value of the high nibble (DB7 to DB4), all the other data pins of the port are reset. */
+    uint16_t set_high[16];
+
+#if defined(STM32F1)
+    /** Bits of the port configuration registers (CRL, CRH) belonging to the data pins. */
+    uint32_t cr_mask[2];
+#else
+    /** Bits of the port mode register (MODER) belonging to the data pins. */
+    uint32_t moder_mask;
+#endif
+} HD44780_DataPort;
+
+/**
+ * Runtime state of a %HD44780 controller instance.
+ * Managed internally by the library, must not be modified by the user.
+ */
+typedef struct
+{
+    /** Last value written to the controller with the entry mode set instruction. */
+    uint8_t entry_mode;
+
+    /** Framebuffer index of the next character written to the framebuffer. */
+    uint8_t fb_cursor;
+
+    /** Copy of the controller address counter, follows every instruction and data write sent to the controller. */
+    uint8_t address;
+
+    /** DDRAM address of the first visible column of each row, computed by HD44780_init() from the geometry. */
+    uint8_t row_offsets[HD44780_MAX_ROWS];
+
+    /** Number of visible rows, @ref HD44780::rows or its default. */
+    uint8_t row_count;
+
+    /** Whether the address counter currently points to CGRAM instead of DDRAM. */
+    bool address_cgram;
+
+    /** Whether the controller increments (I/D = 1) or decrements the address counter after data writes. */
+    bool address_increment;
+
+    /** Whether the controller shifts the display after DDRAM data writes (S = 1 in the entry mode). */
+    bool shift_on_write;
+
+    /** Number of positions the display is shifted to the left, from 0 to the DDRAM line length excluded. */
+    uint8_t display_shift;
+
+    /** DDRAM column of the first column of the page selected with HD44780_page_draw(). */
+    uint8_t page_offset;
+
+    /** Bitmap of the framebuffer cells that differ from the content of the controller DDRAM. */
+    uint8_t fb_dirty[HD44780_DDRAM_SIZE / 8];
+
+    /** Copy of the CGRAM content written by the library. */
+    uint8_t cgram[HD44780_CGRAM_SIZE];
+
+    /** Bitmap of the CGRAM symbol slots whose content is known, the CGRAM content is random at power on. */
+    uint8_t cgram_valid;
+
+    /** Hash of the 8 bytes of each CGRAM symbol slot, speeds up the search for a symbol in HD44780_glyph(). */
+    uint16_t cgram_hash[8];
+
+    /** Value of @ref glyph_clock when each symbol slot was last requested with HD44780_glyph(). */
+    uint16_t glyph_used[8];
+
+    /** Counter incremented by every HD44780_glyph() call. */
+    uint16_t glyph_clock;
+
+    /** Whether the mcu pins connected to the data lines are currently configured as inputs. */
+    bool data_input;
+
+    /** Number of GPIO ports used by the data lines, 0 when they use more than @ref HD44780_MAX_DATA_PORTS ports. */
+    uint8_t data_port_count;
+
+    /** GPIO ports used by the data lines. */
+    HD44780_DataPort data_ports[HD44780_MAX_DATA_PORTS];
+
+    /** Instructions (bit 8 clear) and data bytes (bit 8 set) waiting to be sent in asynchronous mode. */
+    volatile uint16_t queue[HD44780_QUEUE_SIZE];
+
+    /** Index of the next free queue entry, only modified by the producer. */
+    volatile uint8_t queue_head;
+
+    /** Index of the next queue entry to be sent, only modified by HD44780_poll(). */
+    volatile uint8_t queue_tail;
+
+    /**
+     * Whether the last operation sent to the controller might still be executing, set by HD44780_poll() and by the
+     * instances on a @ref HD44780_Bus, which only wait before the next access to the same controller.
+     */
+    volatile bool exec_pending;
+
+    /** Execution time group of the operation left executing, see @ref HD44780_State::exec_estimate. */
+    uint8_t exec_class;
+
+    /** HAL_GetTick() value when the operation left executing was sent. */
+    uint32_t exec_tick;
+
+    /** HD44780_CYCLES() value when the operation left executing was sent, on the cores with a cycle counter. */
+    uint32_t exec_cycles;
+
+    /** Whether the bus is in use, prevents HD44780_poll() calls from an interrupt from interleaving bus operations. */
+    volatile bool bus_locked;
+
+    /** Step of the initialization started by HD44780_init_start(), 0 once completed. */
+    volatile uint8_t init_step;
+
+    /** HAL_GetTick() value at the start of the wait of the current initialization step. */
+    uint32_t init_tick;
+
+    /**
+     * [ns] Execution times of data writes, instructions, and the clear display and return home instructions, learned
+     * from the busy flag. The expected time is waited before polling the busy flag by the synchronous writes. The
+     * instances on a @ref HD44780_Bus only wait the part not yet elapsed before the next access to the same controller,
+     * as measured by the cycle counter, or by HAL_GetTick() on Cortex-M0 and M0+ devices. HD44780_poll() and
+     * HD44780_bus_flush() poll the busy flag right away instead, they have other work to do between the polls.
+     */
+    uint32_t exec_estimate[3];
+} HD44780_State;
+
+struct HD44780;
+
+/**
+ * Bus shared by several controllers connected to the same RS, RW and data lines, each one with its own EN line, e.g.
+ * the two controllers of a 40x4 display or several displays driven by the same pins. Zero initialize it and point the
+ * @ref HD44780::bus member of all the instances to it before calling HD44780_init().
+ */
+typedef struct HD44780_Bus
+{
+    /** Instances on the bus, registered by HD44780_init(). */
+    struct HD44780 *controllers[HD44780_MAX_BUS_CONTROLLERS];
+
+    /** Number of registered instances. */
+    uint8_t controller_count;
+
+    /** Whether the mcu pins connected to the data lines are currently configured as inputs. */
+    bool data_input;
+
+    /** Whether the bus is in use, prevents HD44780_poll() calls from an interrupt from interleaving bus operations. */
+    volatile bool locked;
+
+    /** Whether the EN lines of all the instances are pulsed together. */
+    bool broadcast;
+} HD44780_Bus;
+
+/**
+ * Link to the controller replacing the GPIO pins, e.g. an I2C port expander, set with @ref HD44780::transport.
+ * The controller cannot be read through a transport, the instances using one operate in @ref HD44780::write_only mode
+ * with the 4 bit interface.
+ */
+typedef struct HD44780_Transport
+{
+    /** Optional function preparing the link, called by HD44780_init() before the initialization sequence. */
+    void (*init)(struct HD44780 *lcd);
+
+    /**
+     * Write instructions (rs = false) or data bytes to the controller, each one followed by its execution time before
+     * the next operation can start. The library does not wait after the call, so that the transport can pace a whole
+     * run of bytes on its own.
+     */
+    void (*write)(struct HD44780 *lcd, bool rs, const uint8_t *data, size_t len);
+
+    /**
+     * Write an instruction with a single transfer on DB7 to DB4, as done by the initialization sequence in 8 bit mode.
+     * The transfer must be completed when the call returns, the library then waits for the execution time.
+     */
+    void (*write_init)(struct HD44780 *lcd, uint8_t byte);
+} HD44780_Transport;
+
+/**
+ * Bus cost counters of an instance, see @ref HD44780::stats.
+ */
+typedef struct
+{
+    uint32_t instructions;           /**< Number of instructions written. */
+    uint32_t data_writes;            /**< Number of bytes written to DDRAM or CGRAM. */
+    uint32_t data_reads;             /**< Number of bytes read from DDRAM or CGRAM. */
+    uint32_t en_pulses;              /**< Number of EN pulses, one per transfer on the data lines. */
+    uint32_t busy_polls;             /**< Number of busy flag and address reads. */
+    uint32_t busy_wait_cycles;       /**< [cycles] Time spent waiting for the busy flag to clear. */
+    uint32_t direction_switches;     /**< Number of times the data lines switched between input and output. */
+    uint32_t transactions;           /**< Number of bus transactions, see @ref HD44780::trace. */
+    uint32_t bus_cycles;             /**< [cycles] Total duration of the bus transactions. */
+    uint32_t max_transaction_cycles; /**< [cycles] Duration of the longest bus transaction. */
+} HD44780_Stats;
+
 /**
  * %HD44780 controller instance.
  * Contains all the information on the hardware configuration of the controller,
  * and some required initialization settings.
  */
-typedef struct
+typedef struct HD44780
 {
     GPIO_TypeDef *rs_gpio; /**< GPIO port of the mcu pin connected to the controller's RS line. */
     GPIO_TypeDef *rw_gpio; /**< GPIO port of the mcu pin connected to the controller's RW line. */
@@ -103,6 +396,117 @@ typedef struct
      * @warning The 5x10 dots font only supports single line operation ( @ref single_line = true ).
      */
     bool font_5x10;
+
+    /**
+     * Number of visible columns of the display, e.g. 20 on a 20x4 module. When set, HD44780_put_char(),
+     * HD44780_put_str() and HD44780_write_buf() wrap the text to the next row after the last visible column instead of
+     * writing it to the DDRAM positions that are not displayed. Filling a row moves the cursor to the next row, so a
+     * newline right after it skips a row.
+     *
+     * When 0 the text is not wrapped, and the rows are as long as the DDRAM lines (40 characters, 80 in
+     * @ref single_line mode).
+     */
+    uint8_t columns;
+
+    /**
+     * Number of visible rows of the display, at most @ref HD44780_MAX_ROWS. In two lines mode the third and fourth
+     * rows continue the DDRAM lines of the first and second rows after @ref columns characters, as on 20x4 (0x14, 0x54)
+     * and 16x4 (0x10, 0x50) modules. In @ref single_line mode each row continues the previous one.
+     *
+     * When 0, the display has 2 rows, or 1 in @ref single_line mode.
+     */
+    uint8_t rows;
+
+    /**
+     * The controller's RW line is tied to ground, @ref rw_gpio and @ref rw_pin are not used.
+     * The busy flag cannot be read, so every instruction is followed by a wait for its datasheet execution time plus
+     * @ref HD44780_TIMING_MARGIN.
+     */
+    bool write_only;
+
+    /**
+     * Optional RAM mirror of the controller DDRAM, must point to a buffer of at least @ref HD44780_DDRAM_SIZE bytes.
+     * When set, HD44780_clear(), HD44780_cursor_to(), HD44780_put_char(), HD44780_put_str() and HD44780_write_buf()
+     * only update the buffer, and the changed characters are sent to the controller when HD44780_flush() is called.
+     *
+     * The buffer is indexed by DDRAM position: in two lines mode the first 40 bytes hold the first line and the
+     * following 40 bytes hold the second line.
+     */
+    uint8_t *framebuffer;
+
+    /**
+     * Queue the instructions and data bytes instead of waiting for the controller to execute them, so that the library
+     * functions return without blocking. The queue is drained by calling HD44780_poll(), either periodically from the
+     * main loop or from a timer interrupt.
+     *
+     * @note In @ref write_only mode, HD44780_poll() waits for the execution time of the operation it sends.
+     *
+     * @warning When the queue is drained from an interrupt, the interrupt must be enabled after HD44780_init().
+     */
+    bool async;
+
+    /**
+     * Optional function called by HD44780_poll() in asynchronous mode when all the queued operations have been
+     * executed by the controller.
+     */
+    void (*on_idle)(struct HD44780 *lcd);
+
+    /**
+     * HAL_GetTick() value when the supply of the controller rose, 0 when the controller is powered along with the mcu.
+     * The 40ms power-on wait of the initialization is only performed for the part that has not yet elapsed, so it is
+     * usually skipped when the mcu has already been running for a while.
+     *
+     * @warning Set it again before initializing a controller whose supply was switched off, or after a brownout.
+     */
+    uint32_t power_on_tick;
+
+    /**
+     * Optional bus shared with other instances. All the instances on a bus must use the same RS, RW and data pins and
+     * the same interface width. Instead of waiting for the controller after every operation, the wait happens before
+     * the next access to the same controller, so that the other controllers can be accessed in the meantime.
+     */
+    HD44780_Bus *bus;
+
+    /**
+     * Optional function writing a byte to the instruction (rs = false) or data (rs = true) register: it selects the
+     * register with RW low, then transfers the byte with one EN pulse in 8 bit mode or two in 4 bit mode, including
+     * all the timings of the write cycle. It replaces the generic register access of every write after the
+     * initialization, the library only waits for the execution afterwards. The data lines are outputs when called.
+     * Set by the C++ front end in HD44780.hpp to a version specialized at compile time for a fixed pin map.
+     * Not used by the instances on a @ref bus.
+     */
+    void (*transmit)(struct HD44780 *lcd, bool rs, uint8_t byte);
+
+    /**
+     * Optional link to the controller replacing the GPIO pins, e.g. &HD44780_pcf8574_transport. When set the GPIO and
+     * pin members are not used, and HD44780_init() makes the instance operate in @ref write_only mode with the 4 bit
+     * interface, and clears its @ref bus. The waveform functions are not supported: nothing is compiled and
+     * HD44780_dma_start() fails.
+     */
+    const HD44780_Transport *transport;
+
+    /** State of the @ref transport, e.g. a @ref HD44780_PCF8574. */
+    void *transport_context;
+
+#if defined(HD44780_STATS)
+    /**
+     * Bus cost counters, reset by HD44780_init() and included in the build by defining HD44780_STATS. The waveforms
+     * generated for the DMA functions are not counted. The instructions sent to all the controllers of a bus at once
+     * are counted by each of them, the switch of the shared data lines to outputs only by the first one.
+     */
+    HD44780_Stats stats;
+
+    /**
+     * Optional function called at the start (start = true) and at the end of each bus transaction, e.g. to drive a
+     * pin watched by a logic analyzer or to record a tracing event. A transaction writes an instruction or a run of
+     * data bytes and waits for their execution, or is a HD44780_poll() step accessing the bus. Included in the build
+     * by defining HD44780_STATS.
+     */
+    void (*trace)(struct HD44780 *lcd, bool start);
+#endif
+
+    /** Runtime state of the instance, initialized by HD44780_init(). */
+    HD44780_State state;
 } HD44780;
 
 /**
@@ -141,13 +545,153 @@ typedef struct
     bool shift_rtl;
 } HD44780_Config;
 
+/**
+ * Bar graph drawn with partial block symbols, e.g. a progress bar or a level meter.
+ * Set the position and size, then call HD44780_bar_init() before updating it with HD44780_bar_set().
+ */
+typedef struct
+{
+    /** Column of the first cell, the leftmost one for horizontal bars and the bottom one for vertical bars. */
+    uint8_t column;
+
+    /** Row of the first cell, the bottom one for vertical bars, which extend upwards to row 0 at most. */
+    uint8_t row;
+
+    /** Number of cells. For vertical bars it is limited to row + 1 by HD44780_bar_init(). */
+    uint8_t length;
+
+    /**
+     * Fill the cells from the bottom up, one row for each cell, with 8 levels per cell instead of 5 columns per cell.
+     * Vertical bars use 7 symbols and require the 5x8 dots font.
+     */
+    bool vertical;
+
+    /** Number of filled pixel columns (pixel rows for vertical bars) currently displayed, managed by the library. */
+    uint16_t level;
+} HD44780_Bar;
+
+/**
+ * Right aligned numeric field, only the characters that change are written when its value is updated.
+ * Zero initialize it and set the position and format before the first HD44780_field_set() call.
+ */
+typedef struct
+{
+    /** Column of the first character. */
+    uint8_t column;
+
+    /** Row of the field. */
+    uint8_t row;
+
+    /** Number of characters, at most @ref HD44780_FIELD_WIDTH. Values that do not fit are displayed as '#'. */
+    uint8_t width;
+
+    /** Number of decimals of the fixed point values, e.g. 1 to display 215 as 21.5. */
+    uint8_t decimals;
+
+    /** Pad the value with zeros instead of spaces. */
+    bool zero_pad;
+
+    /** Characters currently displayed, managed by the library. */
+    char text[HD44780_FIELD_WIDTH];
+} HD44780_Field;
+
+/**
+ * Message scrolled across a row with the display shift instruction, see HD44780_ticker_start().
+ * Set the text and row, the other fields are managed by the library.
+ */
+typedef struct
+{
+    /** Null terminated message, repeated end to end. Not copied, must stay valid while the ticker is used. */
+    const char *text;
+
+    /** Row of the ticker. */
+    uint8_t row;
+
+    /** Number of characters of the text. */
+    size_t length;
+
+    /** Index of the character displayed in the first visible column, not taken modulo the text length. */
+    uint32_t position;
+
+    /** Index of the first character not yet written to DDRAM. */
+    uint32_t loaded;
+} HD44780_Ticker;
+
+/**
+ * Updates posted by several tasks or interrupts, written to a single controller by one render task, see
+ * HD44780_channel_write(). Set the lcd and the optional notification, the other fields are managed by the library.
+ *
+ * The posted characters are stored by screen position, so the updates of the same cells pending at the same time are
+ * coalesced and only the latest value is written. The positions are resolved to DDRAM addresses by the render task,
+ * on the page selected with HD44780_page_draw() at that time.
+ */
+typedef struct HD44780_Channel
+{
+    /**
+     * Controller instance, only accessed by the render task except for its geometry (@ref HD44780::columns, rows and
+     * single line mode), which is fixed by the initialization.
+     */
+    HD44780 *lcd;
+
+    /**
+     * Optional function called after each posted update, e.g. to wake up the render task. Called from the context
+     * of the producer, possibly an interrupt.
+     */
+    void (*notify)(struct HD44780_Channel *channel);
+
+    /** User data available to the notification. */
+    void *context;
+
+    /** Pending characters by position (row * row width + column), managed by the library. */
+    uint8_t cells[HD44780_DDRAM_SIZE];
+
+    /** Bitmap of the pending characters, managed by the library. */
+    uint8_t dirty[HD44780_DDRAM_SIZE / 8];
+
+    /** Pending 5x8 symbols by CGRAM slot, managed by the library. */
+    uint8_t glyphs[HD44780_CGRAM_SIZE];
+
+    /** Bitmap of the pending symbols, managed by the library. */
+    uint8_t glyphs_dirty;
+
+    /** Number of updates posted, used by the render task to detect the ones posted while it reads the channel. */
+    volatile uint32_t sequence;
+} HD44780_Channel;
+
 /**
  * Initialize the necessary hardware peripherals, then configure the controller itself.
  * The initial configuration will be the same as calling HD44780_configure() with all the config flags set to false.
+ * Blocks for about 7ms, plus the part of the power-on wait not yet elapsed, see @ref HD44780::power_on_tick.
+ *
+ * @param lcd Controller instance.
+ */
+void HD44780_init(HD44780 *lcd);
+
+/**
+ * Start the initialization of HD44780_init() without blocking, then complete it with HD44780_init_step().
+ * The functions of the library can be called right away: the operations are queued, and the framebuffer is only
+ * flushed, until the initialization completes. Only a full queue, or a function reading the controller, waits for the
+ * completion.
+ *
+ * @note The waits of the sequence are timed with HAL_GetTick(), which must be running.
  *
  * @param lcd Controller instance.
  */
-void HD44780_init(const HD44780 *lcd);
+void HD44780_init_start(HD44780 *lcd);
+
+/**
+ * Advance the initialization started by HD44780_init_start() when the current wait has elapsed, without blocking.
+ * To be called periodically from the main loop or a timer, at least once per millisecond for the shortest startup.
+ *
+ * On completion, the operations queued in the meantime and the framebuffer changes are sent at once. In
+ * @ref HD44780::async mode they are sent by HD44780_poll() instead, which also advances the initialization, so that
+ * calling HD44780_poll() alone is enough.
+ *
+ * @param lcd Controller instance.
+ *
+ * @return Whether the initialization is completed.
+ */
+bool HD44780_init_step(HD44780 *lcd);
 
 /**
  * Update the configuration of the controller.
@@ -156,34 +700,39 @@ void HD44780_init(const HD44780 *lcd);
  *
  * @param config New controller configuration.
  */
-void HD44780_configure(const HD44780 *lcd, const HD44780_Config *config);
+void HD44780_configure(HD44780 *lcd, const HD44780_Config *config);
 
 /**
- * Clear the display and move the cursor to position 0 of the first line.
+ * Clear the display, move the cursor to position 0 of the first line and reset the display shift, so that the first
+ * page is displayed and selected for drawing.
+ *
+ * @note When the @ref HD44780::framebuffer is enabled the display is cleared by filling the framebuffer with spaces,
+ * and the display shift is reset with HD44780_shift_to().
  *
  * @param lcd Controller instance.
  */
-void HD44780_clear(const HD44780 *lcd);
+void HD44780_clear(HD44780 *lcd);
 
 /**
- * Reset display shift to the initial position and move the cursor to position 0 of the first line.
+ * Reset display shift to the initial position and move the cursor to position 0 of the first line, so that the first
+ * page is displayed and selected for drawing.
  *
  * @param lcd Controller instance.
  */
-void HD44780_return_home(const HD44780 *lcd);
+void HD44780_return_home(HD44780 *lcd);
 
 /**
  * Move the cursor to the desired position.
  *
  * @param lcd Controller instance.
  *
- * @param column Index of the desired cursor position in the line. Must be less than 0x50 in single line mode, and less
- * than 0x28 in two lines mode, or the cursor will wrap to the next line causing undefined behaviour.
+ * @param column Index of the desired cursor position in the row. Must be less than @ref HD44780::columns when set,
+ * otherwise less than 0x50 in single line mode and less than 0x28 in two lines mode, or the cursor will wrap to the
+ * next line causing undefined behaviour.
  *
- * @param row Index of the desired row. Must be 0 if the controller is configured for single line mode, and 0 or 1 when
- * the controller is in two lines mode.
+ * @param row Index of the desired row, taken modulo the number of rows (see @ref HD44780::rows).
  */
-void HD44780_cursor_to(const HD44780 *lcd, uint8_t column, uint8_t row);
+void HD44780_cursor_to(HD44780 *lcd, uint8_t column, uint8_t row);
 
 /**
  * Shift the contents of the display right or left by n positions.
@@ -197,7 +746,82 @@ void HD44780_cursor_to(const HD44780 *lcd, uint8_t column, uint8_t row);
  * @param n Number of positions to shift. When the value is positive the diplay will shift left to right,
  * when negative the shift operation will advance right to left.
  */
-void HD44780_shift_display(const HD44780 *lcd, int8_t n);
+void HD44780_shift_display(HD44780 *lcd, int8_t n);
+
+/**
+ * Shift the display to an absolute position, in the shorter direction around the DDRAM line. The current position is
+ * tracked across all the shift, clear and return home instructions, so at most 20 shift instructions are sent in two
+ * lines mode (40 in single line mode), against the 1.52ms of HD44780_return_home() to restore the alignment.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param offset Number of positions the display should be shifted to the left, i.e. the DDRAM column shown in the
+ * first visible column, taken modulo the DDRAM line length (40 positions, 80 in single line mode).
+ */
+void HD44780_shift_to(HD44780 *lcd, uint8_t offset);
+
+/**
+ * Get the number of screens that fit side by side in the DDRAM lines, e.g. 2 on 16x2 and 20x2 modules, 5 on 8x2
+ * modules and 1 on 20x4 modules, whose lower rows already use the second half of the lines.
+ *
+ * @param lcd Controller instance.
+ *
+ * @return Number of pages, 1 when @ref HD44780::columns is not set.
+ */
+uint8_t HD44780_page_count(HD44780 *lcd);
+
+/**
+ * Select the page written by the following operations: the positions passed to HD44780_cursor_to() and the other
+ * functions taking a position are relative to the first column of the page, and text wraps at the end of its rows.
+ * A page can be composed while another one is displayed, then shown at once with HD44780_page_show().
+ *
+ * @param lcd Controller instance.
+ *
+ * @param page Index of the page, taken modulo HD44780_page_count().
+ */
+void HD44780_page_draw(HD44780 *lcd, uint8_t page);
+
+/**
+ * Display a page by shifting the display to its first column with HD44780_shift_to(), which costs one instruction per
+ * column shifted instead of rewriting every character: 16 instructions to flip between the pages of a 16x2 module.
+ * HD44780_clear() and HD44780_return_home() display the first page again and select it for drawing, in both the
+ * direct and the @ref HD44780::framebuffer modes.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param page Index of the page, taken modulo HD44780_page_count().
+ */
+void HD44780_page_show(HD44780 *lcd, uint8_t page);
+
+/**
+ * Start scrolling a message: shift the display back to its initial position, then write the beginning of the text to
+ * the whole DDRAM line of the ticker row, including the columns that are not visible.
+ *
+ * @warning The display shift instruction moves all the rows at the same time, the content of the other rows scrolls
+ * along with the ticker. On 4 rows modules the DDRAM line is shared with the row two rows apart, which is overwritten.
+ *
+ * @note Requires @ref HD44780::columns to be set, and the default left to right entry mode without display shift.
+ * The cursor is left on the ticker row.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param ticker Ticker to start, the text must not be empty.
+ */
+void HD44780_ticker_start(HD44780 *lcd, HD44780_Ticker *ticker);
+
+/**
+ * Scroll a ticker by one character with a single display shift instruction. The columns that scrolled out of view are
+ * refilled with the following characters of the text in a single run, once every 24 steps on a 16 columns display, so
+ * the amortized cost is about 2 operations per step instead of rewriting the whole row.
+ *
+ * @note With the @ref HD44780::framebuffer enabled, call HD44780_flush() before the next step to send the refilled
+ * columns.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param ticker Ticker started with HD44780_ticker_start().
+ */
+void HD44780_ticker_step(HD44780 *lcd, HD44780_Ticker *ticker);
 
 /**
  * Create a user defined character to display in the LCD.
@@ -214,19 +838,66 @@ void HD44780_shift_display(const HD44780 *lcd, int8_t n);
  *
  * @param symbol Array of 5 bit values where each bit will determine whether the corresponding pixel is lit up in its
  * corresponding row.
+ *
+ * @note Only the rows that differ from the content previously written by the library are sent to the controller.
  */
-void HD44780_create_symbol(const HD44780 *lcd, uint8_t address, bool font_5x10, const uint8_t symbol[]);
+void HD44780_create_symbol(HD44780 *lcd, uint8_t address, bool font_5x10, const uint8_t symbol[]);
+
+/**
+ * Get the character code displaying a symbol, uploading it to a CGRAM slot when not already present.
+ * Allows using more symbols than the 8 (4 in 5x10 mode) slots of the controller: when the symbol is not found in CGRAM,
+ * the least recently requested slot is replaced, skipping the slots that are visible in the @ref HD44780::framebuffer
+ * when enabled. Request all the symbols of a screen before drawing it, so that none of them is replaced while in use.
+ *
+ * The symbol height follows the @ref HD44780::font_5x10 setting, 5x10 symbols use two slots and an even code.
+ *
+ * @warning When all the slots are visible, the least recently requested one is replaced anyway and the characters
+ * displaying it change. Slots written with HD44780_create_symbol() may be replaced as well.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param symbol Array of 8 (10 in 5x10 mode) 5 bit values, see HD44780_create_symbol().
+ *
+ * @return Character code to print to display the symbol, in the range from 0 to 7 inclusive.
+ */
+uint8_t HD44780_glyph(HD44780 *lcd, const uint8_t symbol[]);
+
+/**
+ * Load the partial block symbols of a bar with HD44780_glyph(), then draw it empty. The length of a vertical bar is
+ * clamped to the rows available above its bottom row.
+ *
+ * @note Horizontal bars are drawn assuming the default left to right entry mode.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param bar Bar to initialize.
+ */
+void HD44780_bar_init(HD44780 *lcd, HD44780_Bar *bar);
+
+/**
+ * Change the fill level of a bar, only writing the cells whose content changes: a change within the boundary cell
+ * costs a single data write. Full cells use the 0xFF block character of the A00 and A02 character ROMs.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param bar Bar to update.
+ *
+ * @param level Number of filled pixel columns, from 0 to 5 times the bar length, or number of filled pixel rows for
+ * vertical bars, from 0 to 8 times the bar length. Larger values fill the whole bar.
+ */
+void HD44780_bar_set(HD44780 *lcd, HD44780_Bar *bar, uint16_t level);
 
 /**
  * Write a single character to the lcd, then advance the cursor.
- * When the character is '\\n' the cursor will advance to the next line, wrapping around from last to first.
+ * When the character is '\\n' the cursor will advance to the start of the next row, wrapping around from last to first.
+ * When @ref HD44780::columns is set, the cursor moves to the next row after the last visible column is written.
  * When the character is '\\t' 4 spaces will be written to the display.
  *
  * @param lcd Controller instance.
  *
  * @param chr Character to be printed to the lcd.
  */
-void HD44780_put_char(const HD44780 *lcd, uint8_t chr);
+void HD44780_put_char(HD44780 *lcd, uint8_t chr);
 
 /**
  * Write a string to the lcd, then advance the cursor.
@@ -238,6 +909,391 @@ void HD44780_put_char(const HD44780 *lcd, uint8_t chr);
  *
  * @param str String to be printed to the lcd.
  */
-void HD44780_put_str(const HD44780 *lcd, const char *str);
+void HD44780_put_str(HD44780 *lcd, const char *str);
+
+/**
+ * Write a buffer of characters to the lcd, then advance the cursor.
+ * The same considerations for special characters from HD44780_put_char() apply to this function, the characters
+ * between special characters are sent without per character setup of the control lines.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param data Characters to be printed to the lcd, no terminator is required.
+ *
+ * @param len Number of characters to be printed.
+ */
+void HD44780_write_buf(HD44780 *lcd, const uint8_t *data, size_t len);
+
+/**
+ * Move the cursor to the desired position, then write a buffer of characters to the lcd.
+ * See HD44780_cursor_to() and HD44780_write_buf().
+ *
+ * @param lcd Controller instance.
+ *
+ * @param column Index of the position of the first character in the line.
+ *
+ * @param row Index of the row of the first character.
+ *
+ * @param data Characters to be printed to the lcd, no terminator is required.
+ *
+ * @param len Number of characters to be printed.
+ */
+void HD44780_write_buf_at(HD44780 *lcd, uint8_t column, uint8_t row, const uint8_t *data, size_t len);
+
+/**
+ * Write a formatted string to the lcd, without allocating memory and with a small bounded stack usage.
+ * The same considerations for special characters from HD44780_put_char() apply to this function.
+ *
+ * The supported conversions are %d and %i (int), %u, %x and %X (unsigned int), %s, %c and %%, with an optional '-'
+ * flag for left alignment, '0' flag for zero padding and minimum field width. The integer conversions accept the 'h'
+ * modifier and a single 'l' modifier for long arguments, the output stops at any other modifier. The precision of %d,
+ * %i and %u is the number of decimals of a fixed point value, e.g. "%.2d" prints 1234 as 12.34, the precision of %s is
+ * the maximum number of characters printed. Width and precision can be passed as arguments with '*'.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param format Format string.
+ */
+void HD44780_printf(HD44780 *lcd, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Move the cursor to the desired position, then write a formatted string to the lcd.
+ * See HD44780_cursor_to() and HD44780_printf().
+ */
+void HD44780_printf_at(HD44780 *lcd, uint8_t column, uint8_t row, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * Write a formatted string to the lcd, with the arguments passed as a variable argument list. See HD44780_printf().
+ */
+void HD44780_vprintf(HD44780 *lcd, const char *format, va_list args);
+
+/**
+ * Display a new value in a numeric field, only writing the characters that differ from the displayed ones: updating
+ * the last digit of a value costs one address instruction and one data write.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param field Field to update.
+ *
+ * @param value Value to display, with @ref HD44780_Field::decimals decimals.
+ */
+void HD44780_field_set(HD44780 *lcd, HD44780_Field *field, int32_t value);
+
+/**
+ * Send the content of the framebuffer to the controller, then move the cursor to the framebuffer cursor position.
+ * Only the characters that changed since the last flush are written, each run of changed characters costing one
+ * address instruction plus one data write per character.
+ * Has no effect when the @ref HD44780::framebuffer is not enabled.
+ *
+ * @param lcd Controller instance.
+ */
+void HD44780_flush(HD44780 *lcd);
+
+/**
+ * Advance the transmission of the queued operations when the @ref HD44780::async mode is enabled.
+ * Each call sends at most one instruction or data byte, and returns immediately when the controller is still busy
+ * executing the previous one. Safe to call from a single timer interrupt while the main program uses the library.
+ *
+ * @param lcd Controller instance.
+ */
+void HD44780_poll(HD44780 *lcd);
+
+/**
+ * Get the number of operations that have not yet been executed by the controller in @ref HD44780::async mode,
+ * including the one currently executing.
+ *
+ * @param lcd Controller instance.
+ *
+ * @return Number of pending operations, 0 when the controller is idle.
+ */
+uint8_t HD44780_queue_depth(HD44780 *lcd);
+
+/**
+ * Post characters to be written at the desired position by the render task, without accessing the controller.
+ * The characters are clipped at the end of the row, and the special characters are not interpreted.
+ *
+ * Safe to call from any task or interrupt: the update is stored with the interrupts masked for the time of the copy,
+ * so the render task never sees part of it. The controller state that changes at run time, e.g. the drawn page, is
+ * not accessed.
+ *
+ * @param channel Channel of the controller.
+ *
+ * @param column Column of the first character, counted from the first visible column.
+ *
+ * @param row Row of the characters.
+ *
+ * @param data Characters to write.
+ *
+ * @param len Number of characters to write.
+ */
+void HD44780_channel_write(HD44780_Channel *channel, uint8_t column, uint8_t row, const uint8_t *data, size_t len);
+
+/**
+ * Post a null terminated string to be written at the desired position, see HD44780_channel_write().
+ */
+void HD44780_channel_put_str(HD44780_Channel *channel, uint8_t column, uint8_t row, const char *str);
+
+/**
+ * Post a 5x8 symbol to be uploaded to a CGRAM slot by the render task, see HD44780_channel_write().
+ *
+ * @param address Slot of the symbol, from 0 to 7.
+ *
+ * @param symbol The 8 rows of the symbol.
+ */
+void HD44780_channel_glyph(HD44780_Channel *channel, uint8_t address, const uint8_t symbol[]);
+
+/**
+ * Write the pending updates of a channel to the controller, the symbols first. Must only be called by the render
+ * task, the only one accessing the controller. Each run of consecutive pending characters costs one address
+ * instruction plus one data write per character, then the @ref HD44780::framebuffer is flushed when enabled.
+ *
+ * @param channel Channel of the controller.
+ *
+ * @return Whether any update was pending.
+ */
+bool HD44780_channel_render(HD44780_Channel *channel);
+
+/**
+ * Read consecutive DDRAM addresses with the auto-increment of the address counter, one address instruction plus one
+ * data read per byte. The address counter is restored afterwards. Waits until the queued operations are executed.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param address DDRAM address of the first byte, e.g. 0x40 for the first column of the second line.
+ *
+ * @param data Destination of the bytes, in address order. The addresses follow the ones of the characters written in
+ * sequence, continuing from the end of the first line to the second line in two lines mode.
+ *
+ * @param len Number of bytes to read, at most @ref HD44780_DDRAM_SIZE.
+ *
+ * @return Number of bytes read, 0 in @ref HD44780::write_only mode where the controller cannot be read.
+ */
+size_t HD44780_read_ddram(HD44780 *lcd, uint8_t address, uint8_t *data, size_t len);
+
+/**
+ * Read consecutive CGRAM addresses, see HD44780_read_ddram(). Only the 5 least significant bits of each byte are
+ * stored by the controller.
+ *
+ * @param address CGRAM address of the first byte, 8 times the character code for the first row of a 5x8 symbol.
+ *
+ * @param len Number of bytes to read, at most @ref HD44780_CGRAM_SIZE.
+ */
+size_t HD44780_read_cgram(HD44780 *lcd, uint8_t address, uint8_t *data, size_t len);
+
+/**
+ * Check the controller RAM against the content written by the library, then rewrite only the corrupted bytes.
+ * Recovers from glitches (e.g. brownouts or ESD discharges) that altered the RAM while leaving the controller
+ * operating, without the 50ms and more of HD44780_init() followed by a full redraw.
+ *
+ * The CGRAM slots written with HD44780_create_symbol() or HD44780_glyph() are checked, and the whole DDRAM when the
+ * @ref HD44780::framebuffer is enabled, skipping the cells not yet flushed. Reading costs about as much bus time as
+ * writing the same bytes, e.g. 80 data reads for the DDRAM.
+ *
+ * @warning The instruction registers (function set, display control, entry mode) cannot be read back: a controller
+ * that lost its configuration or its interface mode must be initialized again with HD44780_init().
+ *
+ * @param lcd Controller instance.
+ *
+ * @return Number of corrupted bytes that were rewritten, 0 in @ref HD44780::write_only mode where the controller
+ * cannot be read.
+ */
+size_t HD44780_repair(HD44780 *lcd);
+
+/**
+ * Clear the displays of all the instances on a bus, sending a single instruction to all the controllers at once.
+ * See HD44780_clear().
+ *
+ * @param bus Bus of the controller instances.
+ */
+void HD44780_bus_clear(HD44780_Bus *bus);
+
+/**
+ * Configure all the instances on a bus, sending the instructions to all the controllers at once.
+ * See HD44780_configure().
+ *
+ * @param bus Bus of the controller instances.
+ *
+ * @param config Configuration settings.
+ */
+void HD44780_bus_configure(HD44780_Bus *bus, const HD44780_Config *config);
+
+/**
+ * Flush the framebuffers of all the instances on a bus, see HD44780_flush().
+ * The operations of the different controllers are interleaved: while a controller executes an operation, the next
+ * operation is sent to another controller, so the flush takes about as long as the biggest single flush.
+ * The synchronous instances still initializing are skipped, their changes are sent once HD44780_init_step() completes
+ * the initialization.
+ *
+ * @param bus Bus of the controller instances.
+ */
+void HD44780_bus_flush(HD44780_Bus *bus);
+
+/**
+ * Compile the write of a string at the desired position into a waveform: a buffer of GPIO BSRR register values that,
+ * when stored to the port one at a time every tick_ns nanoseconds (e.g. by a timer-paced DMA channel with
+ * HD44780_dma_start()), reproduces the bus transfers including the execution time of every instruction.
+ * The characters are written without any special character handling, and the @ref HD44780::framebuffer is not
+ * updated. The instance assumes that the waveform is transferred before it is used again.
+ *
+ * @note Requires the RS, EN and data lines to be connected to the same GPIO port.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param column Index of the position of the first character in the line, see HD44780_cursor_to().
+ *
+ * @param row Index of the row of the first character, see HD44780_cursor_to().
+ *
+ * @param str Null terminated string to be written.
+ *
+ * @param tick_ns [ns] Time between two consecutive words of the waveform.
+ *
+ * @param words Buffer receiving the waveform.
+ *
+ * @param capacity Size of the buffer in words.
+ *
+ * @return Number of words of the waveform, 0 when the buffer is too small or the wiring is not supported.
+ */
+size_t HD44780_dma_compile_str(HD44780 *lcd,
+                               uint8_t column,
+                               uint8_t row,
+                               const char *str,
+                               uint32_t tick_ns,
+                               uint32_t *words,
+                               size_t capacity);
+
+/**
+ * Compile the content of the @ref HD44780::framebuffer changed since the last flush into a waveform, see
+ * HD44780_dma_compile_str(). On success the framebuffer is considered flushed.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param tick_ns [ns] Time between two consecutive words of the waveform.
+ *
+ * @param words Buffer receiving the waveform.
+ *
+ * @param capacity Size of the buffer in words.
+ *
+ * @return Number of words of the waveform, 0 when nothing changed, the buffer is too small or the wiring is not
+ * supported.
+ */
+size_t HD44780_dma_compile_framebuffer(HD44780 *lcd, uint32_t tick_ns, uint32_t *words, size_t capacity);
+
+/**
+ * Prepare the controller lines for a waveform transfer: drive the data lines, set R/W low and, in asynchronous mode,
+ * wait for the queued operations to complete. Only needed when the transfer is not started with HD44780_dma_start().
+ * The instance must not be used until HD44780_dma_release() is called.
+ *
+ * @param lcd Controller instance.
+ */
+void HD44780_dma_acquire(HD44780 *lcd);
+
+/**
+ * Release the instance after a waveform transfer completed.
+ *
+ * @param lcd Controller instance.
+ */
+void HD44780_dma_release(HD44780 *lcd);
+
+#if defined(HAL_DMA_MODULE_ENABLED) && defined(HAL_TIM_MODULE_ENABLED)
+
+/**
+ * Start streaming a waveform to the GPIO port of the controller lines.
+ * The DMA channel triggered by the update event of the timer must be configured for memory to peripheral word
+ * transfers with memory increment, and the timer period must match the tick of the waveform.
+ * The instance must not be used until HD44780_dma_stop() is called.
+ *
+ * @note On devices where GPIO ports are only reachable by one DMA controller (e.g. DMA2 on stm32f4) the timer must
+ * be connected to that controller.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param htim Timer pacing the transfer, linked to its DMA channel with __HAL_LINKDMA(htim, hdma[TIM_DMA_ID_UPDATE],
+ * hdma).
+ *
+ * @param words Waveform generated by HD44780_dma_compile_str() or HD44780_dma_compile_framebuffer().
+ *
+ * @param count Number of words of the waveform.
+ *
+ * @return HAL status of the operation.
+ */
+HAL_StatusTypeDef HD44780_dma_start(HD44780 *lcd, TIM_HandleTypeDef *htim, const uint32_t *words, size_t count);
+
+/**
+ * Check whether the waveform transfer started with HD44780_dma_start() is still running.
+ *
+ * @param htim Timer pacing the transfer.
+ */
+bool HD44780_dma_busy(TIM_HandleTypeDef *htim);
+
+/**
+ * Stop the waveform transfer and release the instance.
+ *
+ * @param lcd Controller instance.
+ *
+ * @param htim Timer pacing the transfer.
+ */
+void HD44780_dma_stop(HD44780 *lcd, TIM_HandleTypeDef *htim);
+
+#endif
+
+#if defined(HAL_I2C_MODULE_ENABLED)
+
+/**
+ * PCF8574 I2C port expander backpack, wired as P0 = RS, P1 = RW, P2 = EN, P3 = backlight and P4 to P7 = DB4 to DB7.
+ * Set it as the @ref HD44780::transport_context of a 4 bit instance using @ref HD44780_pcf8574_transport.
+ *
+ * The expander outputs of a whole run of characters, including the idle frames that space the operations by their
+ * execution time, are sent in a single I2C transaction instead of one transaction per EN edge.
+ */
+typedef struct
+{
+    /** I2C peripheral connected to the expander. */
+    I2C_HandleTypeDef *hi2c;
+
+    /** Expander address shifted left by one as expected by the HAL, e.g. 0x27 << 1 (0x3F << 1 for the PCF8574A). */
+    uint16_t address;
+
+    /**
+     * [Hz] I2C clock frequency, used to compute the number of idle frames covering the execution times. 0 stands for
+     * 100kHz, the standard mode.
+     */
+    uint32_t clock_hz;
+
+    /** Whether the backlight is on, change it with HD44780_pcf8574_backlight(). */
+    bool backlight;
+
+    /**
+     * Transmit with HAL_I2C_Master_Transmit_DMA() and return while the frames are transferred. The previous transfer
+     * is awaited before the buffer is filled again.
+     */
+    bool dma;
+
+    /** Expander output values waiting to be transmitted, managed by the library. */
+    uint8_t frames[HD44780_PCF8574_FRAMES];
+
+    /** Number of values waiting to be transmitted, managed by the library. */
+    uint16_t count;
+} HD44780_PCF8574;
+
+/**
+ * Transport through a @ref HD44780_PCF8574 backpack.
+ */
+extern const HD44780_Transport HD44780_pcf8574_transport;
+
+/**
+ * Switch the backlight of a PCF8574 backpack on or off, after the queued operations in @ref HD44780::async mode.
+ *
+ * @param lcd Controller instance using @ref HD44780_pcf8574_transport.
+ *
+ * @param on Whether the backlight should be on.
+ */
+void HD44780_pcf8574_backlight(HD44780 *lcd, bool on);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* __HD44780_H__ */
@@ -0,0 +1,479 @@
+/**
+ * @file HD44780.hpp C++ front end of the %HD44780 library, specialized at compile time for a fixed pin map.
+ *
+ * The pin map, the interface width, the geometry and the core clock are template parameters, so the port masks, the
+ * delays and the lookup tables converting the data values to bit set/reset register words are computed by the
+ * compiler. Every register write after the initialization is performed by the front end with constant register
+ * stores: one for RS and RW, then for each EN pulse one table lookup and a store that also raises EN when it is on
+ * the same port as the data lines, and one store lowering EN. The init sequence, the busy flag and execution waits and
+ * all the higher level operations are performed by HD44780.c.
+ *
+ * Requires C++17, all the data lines on the same GPIO port and, without HD44780_DELAY_NS, the DWT cycle counter of
+ * Cortex-M3 and above for the delays.
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#ifndef __HD44780_HPP__
+#define __HD44780_HPP__
+
+#include "HD44780.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * Declare a type selecting a GPIO port, to be used as the Port parameter of @ref hd44780::Pin.
+ * Example: HD44780_PORT(LcdPort, GPIOB);
+ */
+#define HD44780_PORT(name, gpio)                                                                                       \
+    struct name                                                                                                        \
+    {                                                                                                                  \
+        static GPIO_TypeDef *get()                                                                                     \
+        {                                                                                                              \
+            return gpio;                                                                                               \
+        }                                                                                                              \
+    }
+
+namespace hd44780
+{
+
+/**
+ * Mcu pin connected to a controller line.
+ *
+ * @tparam Port Type declared with @ref HD44780_PORT selecting the GPIO port.
+ *
+ * @tparam Mask Pin mask, e.g. GPIO_PIN_5.
+ */
+template <typename Port, uint16_t Mask> struct Pin
+{
+    using port = Port;
+    static constexpr uint16_t mask = Mask;
+};
+
+/**
+ * %HD44780 controller with a pin map fixed at compile time.
+ *
+ * @tparam Columns Number of visible columns, see HD44780::columns.
+ *
+ * @tparam Rows Number of visible rows, see HD44780::rows. Single rows use the single line mode.
+ *
+ * @tparam CoreClock [Hz] Core clock the delays of the write cycle are computed for, e.g. 72000000. The delays are too
+ * short if the core runs faster.
+ *
+ * @tparam RS, RW, EN Pins connected to the control lines.
+ *
+ * @tparam Data Pins connected to the data lines, DB4 to DB7 for the 4 bit interface or DB0 to DB7 for the 8 bit
+ * interface, in this order.
+ */
+template <uint8_t Columns, uint8_t Rows, uint32_t CoreClock, typename RS, typename RW, typename EN, typename... Data>
+class Display
+{
+    static_assert(sizeof...(Data) == 4 || sizeof...(Data) == 8, "The data lines must be DB4-DB7 or DB0-DB7.");
+
+    template <typename First, typename...> struct Front
+    {
+        using type = First;
+    };
+
+    using DataPort = typename Front<Data...>::type::port;
+
+    static_assert((std::is_same<typename Data::port, DataPort>::value && ...),
+                  "All the data lines must be on the same GPIO port, use the C interface otherwise.");
+
+    static constexpr bool interface_8_bit = sizeof...(Data) == 8;
+    static constexpr uint16_t data_masks[] = {Data::mask...};
+    static constexpr bool en_on_data_port = std::is_same<typename EN::port, DataPort>::value;
+    static constexpr bool rw_on_rs_port = std::is_same<typename RW::port, typename RS::port>::value;
+
+    /** [ns] Timings of the write cycle, the same as the ones of HD44780.c. */
+    static constexpr uint32_t t_address_setup = 60;
+    static constexpr uint32_t t_enable_write = 240;
+    static constexpr uint32_t t_enable_cycle = 1000;
+
+    /** Bit set/reset register words driving a group of 4 data lines with the 16 possible nibbles. */
+    struct Table
+    {
+        uint32_t words[16];
+    };
+
+    /**
+     * Build the table of the data lines from first to first + 3. The set and reset bits of the two tables of the 8 bit
+     * interface are disjoint, so their words can be combined with a bitwise or.
+     */
+    static constexpr Table make_table(size_t first)
+    {
+        Table table{};
+
+        for (uint8_t nibble = 0; nibble < 16; ++nibble)
+        {
+            uint32_t set = 0;
+            uint32_t reset = 0;
+
+            for (size_t bit = 0; bit < 4; ++bit)
+            {
+                (nibble & (1 << bit) ? set : reset) |= data_masks[first + bit];
+            }
+
+            table.words[nibble] = set | reset << 16;
+        }
+
+        return table;
+    }
+
+    static constexpr Table low_table = make_table(0);
+    static constexpr Table high_table = make_table(interface_8_bit ? 4 : 0);
+
+    /**
+     * Halt the program execution for at least the desired number of nanoseconds.
+     */
+    template <uint32_t Ns> static inline __attribute__((always_inline)) void delay()
+    {
+#if defined(HD44780_DELAY_NS)
+        HD44780_DELAY_NS(Ns);
+#else
+        static_assert(CoreClock, "The core clock is needed to compute the delays.");
+
+        constexpr uint32_t cycles = ((uint64_t)Ns * CoreClock + 999999999) / 1000000000;
+
+        // The cycle counter is started by HD44780_init().
+        uint32_t start = DWT->CYCCNT;
+
+        while (DWT->CYCCNT - start < cycles)
+            ;
+#endif
+    }
+
+    /**
+     * Pulse EN while driving the data lines with a bit set/reset register word.
+     */
+    static inline __attribute__((always_inline)) void pulse(uint32_t word)
+    {
+        if constexpr (en_on_data_port)
+        {
+            HD44780_GPIO_WRITE(DataPort::get(), BSRR, word | EN::mask);
+        }
+        else
+        {
+            HD44780_GPIO_WRITE(EN::port::get(), BSRR, (uint32_t)EN::mask);
+            HD44780_GPIO_WRITE(DataPort::get(), BSRR, word);
+        }
+
+        delay<t_enable_write>();
+
+        HD44780_GPIO_WRITE(EN::port::get(), BSRR, (uint32_t)EN::mask << 16);
+
+        // Address hold time = 20ns
+    }
+
+  public:
+    /** Underlying C instance, its options (e.g. framebuffer, write_only) can be changed before calling init(). */
+    HD44780 lcd{};
+
+    Display()
+    {
+        GPIO_TypeDef *ports[] = {Data::port::get()...};
+        GPIO_TypeDef **gpios[] = {&lcd.d0_gpio, &lcd.d1_gpio, &lcd.d2_gpio, &lcd.d3_gpio,
+                                  &lcd.d4_gpio, &lcd.d5_gpio, &lcd.d6_gpio, &lcd.d7_gpio};
+        uint16_t *pins[] = {&lcd.d0_pin, &lcd.d1_pin, &lcd.d2_pin, &lcd.d3_pin,
+                            &lcd.d4_pin, &lcd.d5_pin, &lcd.d6_pin, &lcd.d7_pin};
+
+        for (size_t i = 0; i < sizeof...(Data); ++i)
+        {
+            size_t line = interface_8_bit ? i : i + 4;
+            *gpios[line] = ports[i];
+            *pins[line] = data_masks[i];
+        }
+
+        lcd.rs_gpio = RS::port::get();
+        lcd.rw_gpio = RW::port::get();
+        lcd.en_gpio = EN::port::get();
+        lcd.rs_pin = RS::mask;
+        lcd.rw_pin = RW::mask;
+        lcd.en_pin = EN::mask;
+        lcd.interface_8_bit = interface_8_bit;
+        lcd.single_line = Rows == 1;
+        lcd.columns = Columns;
+        lcd.rows = Rows;
+        lcd.transmit = transmit;
+    }
+
+    /**
+     * Write a byte to the instruction or data register, see HD44780::transmit.
+     */
+    static void transmit(HD44780 *, bool rs, uint8_t byte)
+    {
+        // RW is driven low even in write only mode, where it is not used by the controller.
+        constexpr uint32_t rw_low = (uint32_t)RW::mask << 16;
+        uint32_t rs_word = rs ? (uint32_t)RS::mask : (uint32_t)RS::mask << 16;
+
+        if constexpr (rw_on_rs_port)
+        {
+            HD44780_GPIO_WRITE(RS::port::get(), BSRR, rs_word | rw_low);
+        }
+        else
+        {
+            HD44780_GPIO_WRITE(RW::port::get(), BSRR, rw_low);
+            HD44780_GPIO_WRITE(RS::port::get(), BSRR, rs_word);
+        }
+
+        delay<t_address_setup>();
+
+        if constexpr (interface_8_bit)
+        {
+            pulse(high_table.words[byte >> 4] | low_table.words[byte & 0x0F]);
+        }
+        else
+        {
+            pulse(high_table.words[byte >> 4]);
+            delay<t_enable_cycle - t_enable_write>();
+            pulse(high_table.words[byte & 0x0F]);
+        }
+    }
+
+    /** See HD44780_init(). */
+    void init()
+    {
+        HD44780_init(&lcd);
+    }
+
+    /** See HD44780_init_start(). */
+    void init_start()
+    {
+        HD44780_init_start(&lcd);
+    }
+
+    /** See HD44780_init_step(). */
+    bool init_step()
+    {
+        return HD44780_init_step(&lcd);
+    }
+
+    /** See HD44780_configure(). */
+    void configure(const HD44780_Config &config)
+    {
+        HD44780_configure(&lcd, &config);
+    }
+
+    /** See HD44780_clear(). */
+    void clear()
+    {
+        HD44780_clear(&lcd);
+    }
+
+    /** See HD44780_return_home(). */
+    void return_home()
+    {
+        HD44780_return_home(&lcd);
+    }
+
+    /** See HD44780_cursor_to(). */
+    void cursor_to(uint8_t column, uint8_t row)
+    {
+        HD44780_cursor_to(&lcd, column, row);
+    }
+
+    /** See HD44780_shift_display(). */
+    void shift_display(int8_t n)
+    {
+        HD44780_shift_display(&lcd, n);
+    }
+
+    /** See HD44780_shift_to(). */
+    void shift_to(uint8_t offset)
+    {
+        HD44780_shift_to(&lcd, offset);
+    }
+
+    /** See HD44780_page_count(). */
+    uint8_t page_count()
+    {
+        return HD44780_page_count(&lcd);
+    }
+
+    /** See HD44780_page_draw(). */
+    void page_draw(uint8_t page)
+    {
+        HD44780_page_draw(&lcd, page);
+    }
+
+    /** See HD44780_page_show(). */
+    void page_show(uint8_t page)
+    {
+        HD44780_page_show(&lcd, page);
+    }
+
+    /** See HD44780_ticker_start(). */
+    void ticker_start(HD44780_Ticker &ticker)
+    {
+        HD44780_ticker_start(&lcd, &ticker);
+    }
+
+    /** See HD44780_ticker_step(). */
+    void ticker_step(HD44780_Ticker &ticker)
+    {
+        HD44780_ticker_step(&lcd, &ticker);
+    }
+
+    /** See HD44780_create_symbol(). */
+    void create_symbol(uint8_t address, bool font_5x10, const uint8_t symbol[])
+    {
+        HD44780_create_symbol(&lcd, address, font_5x10, symbol);
+    }
+
+    /** See HD44780_glyph(). */
+    uint8_t glyph(const uint8_t symbol[])
+    {
+        return HD44780_glyph(&lcd, symbol);
+    }
+
+    /** See HD44780_bar_init(). */
+    void bar_init(HD44780_Bar &bar)
+    {
+        HD44780_bar_init(&lcd, &bar);
+    }
+
+    /** See HD44780_bar_set(). */
+    void bar_set(HD44780_Bar &bar, uint16_t level)
+    {
+        HD44780_bar_set(&lcd, &bar, level);
+    }
+
+    /** See HD44780_put_char(). */
+    void put_char(uint8_t chr)
+    {
+        HD44780_put_char(&lcd, chr);
+    }
+
+    /** See HD44780_put_str(). */
+    void put_str(const char *str)
+    {
+        HD44780_put_str(&lcd, str);
+    }
+
+    /** See HD44780_write_buf(). */
+    void write_buf(const uint8_t *data, size_t len)
+    {
+        HD44780_write_buf(&lcd, data, len);
+    }
+
+    /** See HD44780_write_buf_at(). */
+    void write_buf_at(uint8_t column, uint8_t row, const uint8_t *data, size_t len)
+    {
+        HD44780_write_buf_at(&lcd, column, row, data, len);
+    }
+
+    /** See HD44780_printf(). */
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        HD44780_vprintf(&lcd, format, args);
+        va_end(args);
+    }
+
+    /** See HD44780_printf_at(). */
+    void printf_at(uint8_t column, uint8_t row, const char *format, ...) __attribute__((format(printf, 4, 5)))
+    {
+        va_list args;
+        va_start(args, format);
+        HD44780_cursor_to(&lcd, column, row);
+        HD44780_vprintf(&lcd, format, args);
+        va_end(args);
+    }
+
+    /** See HD44780_vprintf(). */
+    void vprintf(const char *format, va_list args)
+    {
+        HD44780_vprintf(&lcd, format, args);
+    }
+
+    /** See HD44780_field_set(). */
+    void field_set(HD44780_Field &field, int32_t value)
+    {
+        HD44780_field_set(&lcd, &field, value);
+    }
+
+    /** See HD44780_flush(). */
+    void flush()
+    {
+        HD44780_flush(&lcd);
+    }
+
+    /** See HD44780_poll(). */
+    void poll()
+    {
+        HD44780_poll(&lcd);
+    }
+
+    /** See HD44780_queue_depth(). */
+    uint8_t queue_depth()
+    {
+        return HD44780_queue_depth(&lcd);
+    }
+
+    /** See HD44780_read_ddram(). */
+    size_t read_ddram(uint8_t address, uint8_t *data, size_t len)
+    {
+        return HD44780_read_ddram(&lcd, address, data, len);
+    }
+
+    /** See HD44780_read_cgram(). */
+    size_t read_cgram(uint8_t address, uint8_t *data, size_t len)
+    {
+        return HD44780_read_cgram(&lcd, address, data, len);
+    }
+
+    /** See HD44780_repair(). */
+    size_t repair()
+    {
+        return HD44780_repair(&lcd);
+    }
+
+    /** See HD44780_dma_compile_str(). */
+    size_t dma_compile_str(uint8_t column, uint8_t row, const char *str, uint32_t tick_ns, uint32_t *words,
+                           size_t capacity)
+    {
+        return HD44780_dma_compile_str(&lcd, column, row, str, tick_ns, words, capacity);
+    }
+
+    /** See HD44780_dma_compile_framebuffer(). */
+    size_t dma_compile_framebuffer(uint32_t tick_ns, uint32_t *words, size_t capacity)
+    {
+        return HD44780_dma_compile_framebuffer(&lcd, tick_ns, words, capacity);
+    }
+
+    /** See HD44780_dma_acquire(). */
+    void dma_acquire()
+    {
+        HD44780_dma_acquire(&lcd);
+    }
+
+    /** See HD44780_dma_release(). */
+    void dma_release()
+    {
+        HD44780_dma_release(&lcd);
+    }
+
+#if defined(HAL_DMA_MODULE_ENABLED) && defined(HAL_TIM_MODULE_ENABLED)
+
+    /** See HD44780_dma_start(). */
+    HAL_StatusTypeDef dma_start(TIM_HandleTypeDef *htim, const uint32_t *words, size_t count)
+    {
+        return HD44780_dma_start(&lcd, htim, words, count);
+    }
+
+    /** See HD44780_dma_stop(). */
+    void dma_stop(TIM_HandleTypeDef *htim)
+    {
+        HD44780_dma_stop(&lcd, htim);
+    }
+
+#endif
+};
+
+} // namespace hd44780
+
+#endif /* __HD44780_HPP__ */
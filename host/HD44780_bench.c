@@ -0,0 +1,979 @@
+/**
+ * @file HD44780_bench.c Bus cost benchmark of the %HD44780 library public API, run against the controller model.
+ *
+ * Every workload is replayed for each interface configuration on a freshly initialized controller, and the bus cost
+ * counters collected by the model are printed as a table that can be diffed between releases. The program exits with
+ * a non-zero status when the model detects a timing violation or the displayed content is not the expected one.
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#include "HD44780_sim.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+/** Number of visible columns of the benchmarked display. */
+#define COLUMNS 16
+
+typedef struct
+{
+    const char *name;
+    bool interface_8_bit;
+    bool single_line;
+
+    /** Whether the data lines are written by the C++ front end specialized for the benchmark pin map. */
+    bool specialized;
+
+    /** Transport to a PCF8574 backpack replacing the GPIO pins, NULL for the direct wiring. */
+    const HD44780_Transport *transport;
+
+    /** [Hz] I2C clock of the backpack. */
+    uint32_t i2c_clock_hz;
+} Config;
+
+typedef struct
+{
+    const char *name;
+
+    /** Whether the controller instance uses a framebuffer. */
+    bool framebuffer;
+
+    /** Whether the controller instance uses the asynchronous mode, only the time spent queuing is measured. */
+    bool async;
+
+    /** Whether the controller instance uses the write only mode, with the RW line tied low. */
+    bool write_only;
+
+    /** Execution time scale of the simulated controller in percent once initialized, 0 for the nominal 100. */
+    uint16_t oscillator_scale;
+
+    /**
+     * Whether a second controller instance shares the bus with the first one, it is reachable by the workload through
+     * the bus object and its first row is checked as well.
+     */
+    bool bus;
+
+    /**
+     * Number of rows of a display with the same number of columns as the benchmarked one, whose geometry is passed to
+     * the controller instance. 0 to use the default geometry of the configuration.
+     */
+    uint8_t rows;
+
+    /** Bring the display to the initial state of the workload, not measured. */
+    void (*prepare)(HD44780 *lcd);
+
+    /** Measured workload. */
+    void (*run)(HD44780 *lcd);
+
+    /**
+     * Expected content of the first rows of the display after the workload, @ref COLUMNS characters per row, NULL to
+     * skip the check. The CGRAM symbols are written as the character codes 0x08 to 0x0F, which display the same symbols
+     * as 0x00 to 0x07 and do not terminate the string.
+     */
+    const char *expected;
+} Workload;
+
+/** Address of the benchmarked PCF8574 backpack, as expected by the HAL. */
+#define PCF8574_ADDRESS (0x27 << 1)
+
+static const HD44780_Transport edge_transport;
+
+static const Config configs[] = {
+    {"4bit-2line", false, false, false, NULL, 0},
+    {"8bit-2line", true, false, false, NULL, 0},
+    {"4bit-1line", false, true, false, NULL, 0},
+    {"8bit-1line", true, true, false, NULL, 0},
+    {"4bit-2l-cpp", false, false, true, NULL, 0},
+    {"8bit-2l-cpp", true, false, true, NULL, 0},
+    {"4bit-i2c100", false, false, false, &HD44780_pcf8574_transport, 100000},
+    {"4bit-i2c400", false, false, false, &HD44780_pcf8574_transport, 400000},
+    {"4bit-i2c-pe", false, false, false, &edge_transport, 100000},
+};
+
+/**
+ * Write the registers of an instance with the C++ front end specialized for the benchmark pin map, with EN on the
+ * data port. Defined in HD44780_bench_cpp.cpp.
+ */
+void bench_specialize(HD44780 *lcd);
+
+/*
+ * Per-edge PCF8574 transport
+ */
+
+/**
+ * Send one expander output value in its own I2C transaction.
+ */
+static void edge_frame(HD44780_PCF8574 *pcf, uint8_t frame)
+{
+    HAL_I2C_Master_Transmit(pcf->hi2c, pcf->address, &frame, 1, HAL_MAX_DELAY);
+}
+
+/**
+ * Transfer a nibble as the common backpack drivers do: set up the outputs, then pulse EN, one transaction per edge.
+ */
+static void edge_nibble(HD44780_PCF8574 *pcf, uint8_t frame)
+{
+    edge_frame(pcf, frame);
+    edge_frame(pcf, frame | 0x04);
+    edge_frame(pcf, frame);
+}
+
+static void edge_write(HD44780 *lcd, bool rs, const uint8_t *data, size_t len)
+{
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+    uint8_t control = (rs ? 0x01 : 0) | (pcf->backlight ? 0x08 : 0);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        edge_nibble(pcf, (data[i] & 0xF0) | control);
+        edge_nibble(pcf, (uint8_t)(data[i] << 4) | control);
+
+        // Clear display and return home take 1.52ms, the other operations 37us, with a 25% margin.
+        HD44780_Sim_delay_ns(!rs && data[i] <= 0x03 ? 1900000 : 46250);
+    }
+}
+
+static void edge_write_init(HD44780 *lcd, uint8_t byte)
+{
+    HD44780_PCF8574 *pcf = lcd->transport_context;
+
+    edge_nibble(pcf, (byte & 0xF0) | (pcf->backlight ? 0x08 : 0));
+}
+
+/**
+ * Baseline for @ref HD44780_pcf8574_transport, sending every expander output value in a separate I2C transaction.
+ */
+static const HD44780_Transport edge_transport = {
+    .write = edge_write,
+    .write_init = edge_write_init,
+};
+
+/** [ns] Tick of the waveforms replayed by the DMA workloads, a 1MHz timer update rate. */
+#define DMA_TICK_NS 1000
+
+static const uint8_t glyph[8] = {0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00};
+
+/*
+ * Workloads
+ */
+
+/** Simulated controller of the benchmarked instance, for the workloads injecting faults. */
+static HD44780_Sim *controller;
+
+static void draw_screen(HD44780 *lcd, const char *reading)
+{
+    HD44780_cursor_to(lcd, 0, 0);
+    HD44780_put_str(lcd, "Temp:  ");
+    HD44780_put_str(lcd, reading);
+    HD44780_put_str(lcd, " C   ");
+
+    // In single line mode the second field is drawn in the invisible part of the line, to keep the same bus cost.
+    if (lcd->single_line)
+    {
+        HD44780_cursor_to(lcd, COLUMNS, 0);
+    }
+    else
+    {
+        HD44780_cursor_to(lcd, 0, 1);
+    }
+
+    HD44780_put_str(lcd, "Fan: 1200 rpm   ");
+}
+
+static void prepare_screen(HD44780 *lcd)
+{
+    draw_screen(lcd, "21.4");
+    HD44780_flush(lcd);
+}
+
+static void run_serialized_updates(HD44780 *lcd)
+{
+    // Each producer writes its own update to the controller while holding the lock.
+    HD44780_cursor_to(lcd, 7, 0);
+    HD44780_put_str(lcd, "21.3");
+    HD44780_cursor_to(lcd, 7, 0);
+    HD44780_put_str(lcd, "21.6");
+    HD44780_cursor_to(lcd, 7, 0);
+    HD44780_put_str(lcd, "21.5");
+    HD44780_flush(lcd);
+}
+
+static void run_channel_updates(HD44780 *lcd)
+{
+    HD44780_Channel channel = {.lcd = lcd};
+
+    // The producers post before the render task runs, only the latest value of each cell is written.
+    HD44780_channel_put_str(&channel, 7, 0, "21.3");
+    HD44780_channel_put_str(&channel, 7, 0, "21.6");
+    HD44780_channel_put_str(&channel, 7, 0, "21.5");
+    HD44780_channel_render(&channel);
+}
+
+static void run_clear(HD44780 *lcd)
+{
+    HD44780_clear(lcd);
+    HD44780_flush(lcd);
+}
+
+static void run_redraw(HD44780 *lcd)
+{
+    draw_screen(lcd, "21.5");
+    HD44780_flush(lcd);
+}
+
+static void run_field_update(HD44780 *lcd)
+{
+    HD44780_cursor_to(lcd, 10, 0);
+    HD44780_put_str(lcd, "5");
+    HD44780_flush(lcd);
+}
+
+static void run_buffer_field(HD44780 *lcd)
+{
+    // Fixed width field without terminator.
+    static const uint8_t field[] = {'2', '1', '.', '5'};
+
+    HD44780_write_buf_at(lcd, 7, 0, field, sizeof(field));
+    HD44780_flush(lcd);
+}
+
+static void run_printf_field(HD44780 *lcd)
+{
+    HD44780_printf_at(lcd, 7, 0, "%4.1d", 215);
+    HD44780_flush(lcd);
+}
+
+static void run_printf_conversions(HD44780 *lcd)
+{
+    HD44780_printf_at(lcd, 0, 0, "%x %04X %c%c %d%%  ", 0x2Au, 0xBEu, 'O', 'K', 42);
+    HD44780_printf_at(lcd, 0, 1, "%-6.4s|%6.3s|%-2c", "Temperature", "Fan speed", '!');
+    HD44780_printf_at(lcd, 0, 2, "%04d %d", -7, INT_MIN);
+    HD44780_printf_at(lcd, 0, 3, "%-4d|%.2d|%*d| ", -3, -5, 3, 7);
+    HD44780_flush(lcd);
+}
+
+static HD44780_Field field;
+
+static void prepare_field(HD44780 *lcd)
+{
+    prepare_screen(lcd);
+
+    field = (HD44780_Field){.column = 7, .row = 0, .width = 4, .decimals = 1};
+    HD44780_field_set(lcd, &field, 214);
+    HD44780_flush(lcd);
+}
+
+static void run_field_set(HD44780 *lcd)
+{
+    HD44780_field_set(lcd, &field, 215);
+    HD44780_flush(lcd);
+}
+
+static void prepare_marked_field(HD44780 *lcd)
+{
+    prepare_field(lcd);
+
+    // The tens digit is replaced behind the library, it stays displayed as long as the digit does not change.
+    HD44780_Sim_poke(controller, false, 0x07, '*');
+}
+
+static void run_field_digits(HD44780 *lcd)
+{
+    HD44780_field_set(lcd, &field, 209);
+    HD44780_flush(lcd);
+}
+
+static void run_bus_sequential_flush(HD44780 *lcd)
+{
+    for (uint8_t i = 0; i < lcd->bus->controller_count; ++i)
+    {
+        draw_screen(lcd->bus->controllers[i], "21.5");
+        HD44780_flush(lcd->bus->controllers[i]);
+    }
+}
+
+static void run_bus_interleaved_flush(HD44780 *lcd)
+{
+    for (uint8_t i = 0; i < lcd->bus->controller_count; ++i)
+    {
+        draw_screen(lcd->bus->controllers[i], "21.5");
+    }
+
+    HD44780_bus_flush(lcd->bus);
+}
+
+static void run_bus_sequential_clear(HD44780 *lcd)
+{
+    for (uint8_t i = 0; i < lcd->bus->controller_count; ++i)
+    {
+        HD44780_clear(lcd->bus->controllers[i]);
+    }
+}
+
+static void run_bus_broadcast_clear(HD44780 *lcd)
+{
+    HD44780_bus_clear(lcd->bus);
+}
+
+static void run_cursor_to(HD44780 *lcd)
+{
+    for (uint8_t column = 0; column < COLUMNS; ++column)
+    {
+        HD44780_cursor_to(lcd, column, 0);
+    }
+}
+
+static void run_glyph_upload(HD44780 *lcd)
+{
+    for (uint8_t address = 0; address < 8; ++address)
+    {
+        HD44780_create_symbol(lcd, address, false, glyph);
+    }
+}
+
+/** Build the bitmap of one of the icons used by the glyph cache workloads. */
+static void icon(uint8_t index, uint8_t bitmap[8])
+{
+    for (uint8_t row = 0; row < 8; ++row)
+    {
+        bitmap[row] = (index * 7 + row * 5 + 1) & 0x1F;
+    }
+}
+
+/** Request a range of icons to the glyph cache and draw them on the first row. */
+static void draw_icons(HD44780 *lcd, uint8_t first, uint8_t count)
+{
+    uint8_t codes[8];
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint8_t bitmap[8];
+        icon(first + i, bitmap);
+        codes[i] = HD44780_glyph(lcd, bitmap);
+    }
+
+    HD44780_write_buf_at(lcd, 0, 0, codes, count);
+    HD44780_flush(lcd);
+}
+
+static void prepare_icons(HD44780 *lcd)
+{
+    draw_icons(lcd, 0, 6);
+}
+
+static void run_icon_screen_change(HD44780 *lcd)
+{
+    // The second screen shares two icons with the first one.
+    draw_icons(lcd, 4, 6);
+}
+
+static void run_icon_redraw(HD44780 *lcd)
+{
+    draw_icons(lcd, 0, 6);
+}
+
+static HD44780_Bar bar;
+
+static void prepare_bar(HD44780 *lcd)
+{
+    bar = (HD44780_Bar){.column = 0, .row = 0, .length = COLUMNS};
+    HD44780_bar_init(lcd, &bar);
+    HD44780_bar_set(lcd, &bar, 37);
+    HD44780_flush(lcd);
+}
+
+static void run_bar_step(HD44780 *lcd)
+{
+    HD44780_bar_set(lcd, &bar, 38);
+    HD44780_flush(lcd);
+}
+
+static void run_bar_boundary_step(HD44780 *lcd)
+{
+    HD44780_bar_set(lcd, &bar, 42);
+    HD44780_flush(lcd);
+}
+
+static void prepare_vertical_bar(HD44780 *lcd)
+{
+    HD44780_cursor_to(lcd, 0, 0);
+    HD44780_put_str(lcd, "Temp:  21.5 C   Fan: 1200 rpm   Up: 12d 04h 33m Load: 42%");
+
+    // The bottom cell on the second row, the third cell requested does not fit above it and is clamped away.
+    bar = (HD44780_Bar){.column = 0, .row = 1, .length = 3, .vertical = true};
+    HD44780_bar_init(lcd, &bar);
+    HD44780_bar_set(lcd, &bar, 11);
+    HD44780_flush(lcd);
+}
+
+static void run_vertical_bar_step(HD44780 *lcd)
+{
+    // The top cell is half filled.
+    HD44780_bar_set(lcd, &bar, 12);
+    HD44780_flush(lcd);
+}
+
+static void prepare_scroll(HD44780 *lcd)
+{
+    // The second field follows the first one on the first DDRAM line, as drawn in single line mode.
+    prepare_screen(lcd);
+    HD44780_cursor_to(lcd, COLUMNS, 0);
+    HD44780_put_str(lcd, "Fan: 1200 rpm   ");
+}
+
+static void run_scroll(HD44780 *lcd)
+{
+    for (uint8_t i = 0; i < 40; ++i)
+    {
+        HD44780_shift_display(lcd, 1);
+    }
+
+    // The tracked shift wrapped around in two lines mode, and is half a line away in single line mode.
+    HD44780_shift_to(lcd, COLUMNS);
+}
+
+/** Scrolling alert message, longer than the 40 columns of a DDRAM line. */
+static const char ticker_text[] = "ALERT: coolant pressure low, check pump 2 and valve V3.   ";
+
+/** Number of frames scrolled by the ticker workloads, in two lines mode the columns out of view are refilled once. */
+#define TICKER_FRAMES 30
+
+static HD44780_Ticker ticker;
+
+static void prepare_ticker(HD44780 *lcd)
+{
+    ticker = (HD44780_Ticker){.text = ticker_text, .row = 0};
+    HD44780_ticker_start(lcd, &ticker);
+}
+
+static void run_ticker(HD44780 *lcd)
+{
+    for (uint8_t i = 0; i < TICKER_FRAMES; ++i)
+    {
+        HD44780_ticker_step(lcd, &ticker);
+    }
+}
+
+static void prepare_rewrite_scroll(HD44780 *lcd)
+{
+    HD44780_write_buf_at(lcd, 0, 0, (const uint8_t *)ticker_text, COLUMNS);
+}
+
+static void run_rewrite_scroll(HD44780 *lcd)
+{
+    for (uint8_t i = 1; i <= TICKER_FRAMES; ++i)
+    {
+        HD44780_write_buf_at(lcd, 0, 0, (const uint8_t *)ticker_text + i, COLUMNS);
+    }
+}
+
+static void draw_page(HD44780 *lcd, uint8_t page, const char *temperature)
+{
+    HD44780_page_draw(lcd, page);
+    HD44780_cursor_to(lcd, 0, 0);
+    HD44780_printf(lcd, "Temp:  %s C   Fan: 1200 rpm   ", temperature);
+    HD44780_flush(lcd);
+}
+
+static void prepare_pages(HD44780 *lcd)
+{
+    draw_page(lcd, 0, "21.4");
+    draw_page(lcd, 1, "21.5");
+}
+
+static void run_page_flip(HD44780 *lcd)
+{
+    HD44780_page_show(lcd, 1);
+}
+
+static void run_page_compose(HD44780 *lcd)
+{
+    draw_page(lcd, 1, "21.5");
+    HD44780_page_show(lcd, 1);
+}
+
+static void run_page_clear(HD44780 *lcd)
+{
+    // The clear shows and selects the first page again, the cursor position is relative to it.
+    HD44780_page_show(lcd, 1);
+    HD44780_clear(lcd);
+    HD44780_cursor_to(lcd, 0, 1);
+    HD44780_put_str(lcd, "Cleared");
+    HD44780_flush(lcd);
+}
+
+static void prepare_symbol_screen(HD44780 *lcd)
+{
+    prepare_screen(lcd);
+    HD44780_create_symbol(lcd, 0, false, glyph);
+}
+
+static void prepare_glitch(HD44780 *lcd)
+{
+    prepare_symbol_screen(lcd);
+
+    // A glitch altered two characters of the first row, one of the second field and a row of the symbol.
+    HD44780_Sim_poke(controller, false, 0x02, '#');
+    HD44780_Sim_poke(controller, false, 0x08, 0xFF);
+    HD44780_Sim_poke(controller, false, lcd->single_line ? COLUMNS + 1 : 0x41, '?');
+    HD44780_Sim_poke(controller, true, 3, 0x00);
+}
+
+static void run_repair(HD44780 *lcd)
+{
+    HD44780_repair(lcd);
+}
+
+static void run_reinit_redraw(HD44780 *lcd)
+{
+    // Recovery without readback: the controller is initialized again, and the whole screen and symbol are rewritten.
+    // The supply dipped along with the glitch, so the power-on wait is performed again.
+    lcd->power_on_tick = HAL_GetTick();
+    HD44780_init(lcd);
+    HD44780_create_symbol(lcd, 0, false, glyph);
+    draw_screen(lcd, "21.4");
+    HD44780_flush(lcd);
+}
+
+static void run_stepped_init(HD44780 *lcd)
+{
+    // The whole initialization is measured, with the main loop stepping it once per millisecond.
+    HD44780_init_start(lcd);
+    HD44780_create_symbol(lcd, 0, false, glyph);
+    draw_screen(lcd, "21.5");
+    HD44780_flush(lcd);
+
+    while (!HD44780_init_step(lcd))
+    {
+        HAL_Delay(1);
+    }
+}
+
+static void run_dma_redraw(HD44780 *lcd)
+{
+    static uint32_t words[8192];
+
+    // The second field is positioned as in draw_screen().
+    uint8_t column = lcd->single_line ? COLUMNS : 0;
+    uint8_t row = lcd->single_line ? 0 : 1;
+    size_t capacity = sizeof(words) / sizeof(words[0]);
+
+    HD44780_dma_acquire(lcd);
+
+    size_t count = HD44780_dma_compile_str(lcd, 0, 0, "Temp:  21.5 C   ", DMA_TICK_NS, words, capacity);
+    HD44780_Sim_replay(lcd->en_gpio, words, count, DMA_TICK_NS);
+
+    count = HD44780_dma_compile_str(lcd, column, row, "Fan: 1200 rpm   ", DMA_TICK_NS, words, capacity);
+    HD44780_Sim_replay(lcd->en_gpio, words, count, DMA_TICK_NS);
+
+    HD44780_dma_release(lcd);
+}
+
+static void run_dma_overflow(HD44780 *lcd)
+{
+    static uint32_t words[16];
+
+    // The waveforms do not fit, the writes fall back to the processor and rely on the tracked state being unchanged.
+    HD44780_cursor_to(lcd, 0, 0);
+    HD44780_put_str(lcd, "Temp:  21.5 C   ");
+
+    HD44780_dma_acquire(lcd);
+    HD44780_dma_compile_str(lcd, 0, 1, "Fan: 1200 rpm   ", DMA_TICK_NS, words, sizeof(words) / sizeof(words[0]));
+    HD44780_dma_release(lcd);
+
+    HD44780_put_str(lcd, "Fan: 1200 rpm   ");
+}
+
+static void run_fb_dma_overflow(HD44780 *lcd)
+{
+    static uint32_t words[16];
+
+    draw_screen(lcd, "21.5");
+
+    HD44780_dma_acquire(lcd);
+    HD44780_dma_compile_framebuffer(lcd, DMA_TICK_NS, words, sizeof(words) / sizeof(words[0]));
+    HD44780_dma_release(lcd);
+
+    HD44780_flush(lcd);
+}
+
+static void run_wrapped_text(HD44780 *lcd)
+{
+    // The first two rows are filled and wrapped, the third one is terminated by a newline.
+    HD44780_cursor_to(lcd, 0, 0);
+    HD44780_put_str(lcd, "Temp:  21.5 C   Fan: 1200 rpm   Up: 12d 04h 33m\nLoad: 42%");
+    HD44780_flush(lcd);
+}
+
+static const Workload workloads[] = {
+    {"clear", false, false, false, 0, false, 0, prepare_screen, run_clear, "                "},
+    {"full-screen redraw", false, false, false, 0, false, 0, prepare_screen, run_redraw, "Temp:  21.5 C   "},
+    {"single-field update", false, false, false, 0, false, 0, prepare_screen, run_field_update, "Temp:  21.5 C   "},
+    {"write_buf field", false, false, false, 0, false, 0, prepare_screen, run_buffer_field, "Temp:  21.5 C   "},
+    {"printf field", false, false, false, 0, false, 0, prepare_screen, run_printf_field, "Temp:  21.5 C   "},
+    {"numeric field update", false, false, false, 0, false, 0, prepare_field, run_field_set, "Temp:  21.5 C   "},
+    {"numeric field digits", false, false, false, 0, false, 0, prepare_marked_field, run_field_digits,
+     "Temp:  *0.9 C   "},
+    {"printf conversions", false, false, false, 0, false, 4, NULL, run_printf_conversions,
+     "2a 00BE OK 42%  Temp  |   Fan|! -007 -2147483648-3  |-0.05|  7| "},
+    {"serialized updates x3", false, false, false, 0, false, 0, prepare_screen, run_serialized_updates,
+     "Temp:  21.5 C   "},
+    {"channel updates x3", false, false, false, 0, false, 0, prepare_screen, run_channel_updates, "Temp:  21.5 C   "},
+    {"wo write_buf field", false, false, true, 0, false, 0, prepare_screen, run_buffer_field, "Temp:  21.5 C   "},
+    {"cursor_to x16", false, false, false, 0, false, 0, NULL, run_cursor_to, NULL},
+    {"8-glyph upload", false, false, false, 0, false, 0, NULL, run_glyph_upload, "                "},
+    {"glyph cache redraw", false, false, false, 0, false, 0, prepare_icons, run_icon_redraw,
+     "\x08\x09\x0A\x0B\x0C\x0D          "},
+    {"glyph cache new screen", false, false, false, 0, false, 0, prepare_icons, run_icon_screen_change,
+     "\x0C\x0D\x0E\x0F\x08\x09          "},
+    {"bar 1-pixel step", false, false, false, 0, false, 0, prepare_bar, run_bar_step,
+     "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x0A        "},
+    {"bar boundary step", false, false, false, 0, false, 0, prepare_bar, run_bar_boundary_step,
+     "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x09       "},
+    {"vertical bar step", false, false, false, 0, false, 4, prepare_vertical_bar, run_vertical_bar_step,
+     "\x0B" "emp:  21.5 C   \xFF" "an: 1200 rpm   Up: 12d 04h 33m Load: 42%       "},
+    {"40-step scroll and seek", false, false, false, 0, false, 0, prepare_scroll, run_scroll, "Fan: 1200 rpm   "},
+    {"rewrite scroll x30", false, false, false, 0, false, 2, prepare_rewrite_scroll, run_rewrite_scroll,
+     "heck pump 2 and "},
+    {"page compose and flip", false, false, false, 0, false, 2, prepare_screen, run_page_compose,
+     "Temp:  21.5 C   Fan: 1200 rpm   "},
+    {"page flip", false, false, false, 0, false, 2, prepare_pages, run_page_flip, "Temp:  21.5 C   Fan: 1200 rpm   "},
+    {"page flip and clear", false, false, false, 0, false, 2, prepare_pages, run_page_clear,
+     "                Cleared         "},
+    {"fb page flip and clear", true, false, false, 0, false, 2, prepare_pages, run_page_clear,
+     "                Cleared         "},
+    {"ticker scroll x30", false, false, false, 0, false, 2, prepare_ticker, run_ticker, "heck pump 2 and "},
+    {"fb full-screen redraw", true, false, false, 0, false, 0, prepare_screen, run_redraw, "Temp:  21.5 C   "},
+    {"fb single-field update", true, false, false, 0, false, 0, prepare_screen, run_field_update, "Temp:  21.5 C   "},
+    {"async full-screen redraw", false, true, false, 0, false, 0, prepare_screen, run_redraw, "Temp:  21.5 C   "},
+    {"slow clone redraw", false, false, false, 150, false, 0, prepare_screen, run_redraw, "Temp:  21.5 C   "},
+    {"wo full-screen redraw", false, false, true, 0, false, 0, prepare_screen, run_redraw, "Temp:  21.5 C   "},
+    {"wo 8-glyph upload", false, false, true, 0, false, 0, NULL, run_glyph_upload, "                "},
+    {"dma full-screen redraw", false, false, false, 0, false, 0, prepare_screen, run_dma_redraw, "Temp:  21.5 C   "},
+    {"dma overflow fallback", false, false, false, 0, false, 2, NULL, run_dma_overflow,
+     "Temp:  21.5 C   Fan: 1200 rpm   "},
+    {"fb dma overflow fallback", true, false, false, 0, false, 0, prepare_screen, run_fb_dma_overflow,
+     "Temp:  21.5 C   "},
+    {"fb repair clean", true, false, false, 0, false, 0, prepare_symbol_screen, run_repair, "Temp:  21.4 C   "},
+    {"fb repair glitch", true, false, false, 0, false, 0, prepare_glitch, run_repair, "Temp:  21.4 C   "},
+    {"fb reinit and redraw", true, false, false, 0, false, 0, prepare_glitch, run_reinit_redraw, "Temp:  21.4 C   "},
+    {"stepped init and redraw", false, false, false, 0, false, 0, NULL, run_stepped_init, "Temp:  21.5 C   "},
+    {"fb stepped init, redraw", true, false, false, 0, false, 0, NULL, run_stepped_init, "Temp:  21.5 C   "},
+    {"bus sequential flush", true, false, false, 0, true, 0, NULL, run_bus_sequential_flush, "Temp:  21.5 C   "},
+    {"bus interleaved flush", true, false, false, 0, true, 0, NULL, run_bus_interleaved_flush, "Temp:  21.5 C   "},
+    {"bus sequential clear", false, false, false, 0, true, 0, NULL, run_bus_sequential_clear, "                "},
+    {"bus broadcast clear", false, false, false, 0, true, 0, NULL, run_bus_broadcast_clear, "                "},
+    {"16x4 wrapped text", false, false, false, 0, false, 4, NULL, run_wrapped_text,
+     "Temp:  21.5 C   Fan: 1200 rpm   Up: 12d 04h 33m Load: 42%       "},
+    {"fb 16x4 wrapped text", true, false, false, 0, false, 4, NULL, run_wrapped_text,
+     "Temp:  21.5 C   Fan: 1200 rpm   Up: 12d 04h 33m Load: 42%       "},
+};
+
+/*
+ * Benchmark runner
+ */
+
+/**
+ * Check whether a workload can run on a configuration: the transports do not support the bus and waveform functions,
+ * and cannot wait for slow controllers or read the controller RAM without the RW line.
+ */
+static bool supported(const Config *config, const Workload *workload)
+{
+    return !config->transport || (!workload->bus && !workload->oscillator_scale && workload->run != run_dma_redraw &&
+                                  workload->run != run_dma_overflow && workload->run != run_fb_dma_overflow &&
+                                  workload->run != run_repair);
+}
+
+static void init_instance(HD44780 *lcd, const Config *config, const Workload *workload, uint8_t *framebuffer,
+                          HD44780_Bus *bus)
+{
+    static I2C_HandleTypeDef hi2c;
+    static HD44780_PCF8574 backpack;
+
+    *lcd = (HD44780){
+        .rs_gpio = GPIOB,
+        .rw_gpio = GPIOB,
+        .en_gpio = GPIOB,
+        .d0_gpio = GPIOB,
+        .d1_gpio = GPIOB,
+        .d2_gpio = GPIOB,
+        .d3_gpio = GPIOB,
+        .d4_gpio = GPIOB,
+        .d5_gpio = GPIOB,
+        .d6_gpio = GPIOB,
+        .d7_gpio = GPIOB,
+        .rs_pin = GPIO_PIN_0,
+        .rw_pin = GPIO_PIN_1,
+        .en_pin = GPIO_PIN_2,
+        .d0_pin = GPIO_PIN_8,
+        .d1_pin = GPIO_PIN_9,
+        .d2_pin = GPIO_PIN_10,
+        .d3_pin = GPIO_PIN_11,
+        .d4_pin = GPIO_PIN_12,
+        .d5_pin = GPIO_PIN_13,
+        .d6_pin = GPIO_PIN_14,
+        .d7_pin = GPIO_PIN_15,
+        .interface_8_bit = config->interface_8_bit,
+        .single_line = config->single_line,
+        .write_only = workload->write_only,
+        .framebuffer = workload->framebuffer ? framebuffer : NULL,
+        .async = workload->async,
+        .bus = workload->bus ? bus : NULL,
+        .columns = workload->rows ? COLUMNS : 0,
+        .rows = workload->rows,
+    };
+
+    if (config->specialized)
+    {
+        bench_specialize(lcd);
+    }
+
+    if (config->transport)
+    {
+        hi2c = (I2C_HandleTypeDef){.Init = {.ClockSpeed = config->i2c_clock_hz}, .State = HAL_I2C_STATE_READY};
+        backpack = (HD44780_PCF8574){
+            .hi2c = &hi2c,
+            .address = PCF8574_ADDRESS,
+            .clock_hz = config->i2c_clock_hz,
+            .backlight = true,
+        };
+
+        lcd->transport = config->transport;
+        lcd->transport_context = &backpack;
+    }
+}
+
+/**
+ * Execute the operations left in the queues by asynchronous workloads and by the instances on a bus.
+ */
+static void drain(HD44780 *const *instances, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        while (HD44780_queue_depth(instances[i]))
+        {
+            HD44780_poll(instances[i]);
+        }
+    }
+}
+
+/**
+ * Compare the counters kept by the library with the ones observed by the model.
+ */
+static bool stats_match(const HD44780_Stats *stats, const HD44780_Sim_Counters *counters)
+{
+    return stats->instructions == counters->instructions && stats->data_writes == counters->data_writes &&
+           stats->data_reads == counters->data_reads && stats->en_pulses == counters->en_pulses &&
+           stats->busy_polls == counters->busy_polls && stats->direction_switches == counters->direction_switches;
+}
+
+/**
+ * Check that the first cells of the first row display the bitmaps of a range of icons.
+ */
+static bool icons_displayed(uint8_t first, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint8_t bitmap[8];
+        icon(first + i, bitmap);
+
+        uint8_t slot = HD44780_Sim_visible_char(controller, i, 0) % 8;
+
+        for (uint8_t row = 0; row < 8; ++row)
+        {
+            if (HD44780_Sim_cgram(controller, slot * 8 + row) != bitmap[row])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Compare the CGRAM content of the controller with the symbols created by the workload: the displayed character codes
+ * do not tell whether a reused slot holds the right bitmap.
+ */
+static bool cgram_match(const Workload *workload)
+{
+    if (workload->run == run_glyph_upload)
+    {
+        for (uint8_t address = 0; address < HD44780_CGRAM_SIZE; ++address)
+        {
+            if (HD44780_Sim_cgram(controller, address) != glyph[address % 8])
+            {
+                return false;
+            }
+        }
+    }
+
+    if (workload->run == run_vertical_bar_step)
+    {
+        // Symbol of the top cell, with its four bottom pixel rows lit.
+        uint8_t slot = HD44780_Sim_visible_char(controller, 0, 0) % 8;
+
+        for (uint8_t row = 0; row < 8; ++row)
+        {
+            if (HD44780_Sim_cgram(controller, slot * 8 + row) != (row < 4 ? 0x00 : 0x1F))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (workload->run == run_icon_redraw)
+    {
+        return icons_displayed(0, 6);
+    }
+
+    if (workload->run == run_icon_screen_change)
+    {
+        return icons_displayed(4, 6);
+    }
+
+    return true;
+}
+
+static bool run_workload(const Config *config, const Workload *workload)
+{
+    static uint8_t framebuffers[2][HD44780_DDRAM_SIZE];
+
+    HD44780_Bus bus = {0};
+    HD44780 instances[2];
+    HD44780 *lcd = &instances[0];
+    size_t count = workload->bus ? 2 : 1;
+
+    HD44780_Sim_reset();
+
+    HD44780_Sim *sims[2];
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        init_instance(&instances[i], config, workload, framebuffers[i], &bus);
+
+        // The second controller on the bus only has its own EN line.
+        instances[i].en_pin = i ? GPIO_PIN_3 : GPIO_PIN_2;
+
+        uint8_t rows = workload->rows ? workload->rows : config->single_line ? 1 : 2;
+        sims[i] = config->transport ? HD44780_Sim_attach_pcf8574(PCF8574_ADDRESS, COLUMNS, rows)
+                                    : HD44780_Sim_attach(&instances[i], COLUMNS, rows);
+    }
+
+    // All the controllers are powered at once, along with the mcu.
+    for (size_t i = 0; i < count; ++i)
+    {
+        HD44780_init(&instances[i]);
+
+        // The fixed waits of the initialization by instruction only cover the datasheet oscillator, so the model is
+        // slowed down once initialized.
+        if (workload->oscillator_scale)
+        {
+            HD44780_Sim_set_oscillator_scale(sims[i], workload->oscillator_scale);
+        }
+    }
+
+    controller = sims[0];
+
+    if (workload->prepare)
+    {
+        workload->prepare(lcd);
+    }
+
+    HD44780 *const pointers[2] = {&instances[0], &instances[1]};
+    drain(pointers, count);
+
+    HD44780_Sim_reset_counters();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        memset(&instances[i].stats, 0, sizeof(instances[i].stats));
+    }
+
+    workload->run(lcd);
+
+    HD44780_Sim_Counters measured = *HD44780_Sim_counters();
+    const HD44780_Sim_Counters *counters = &measured;
+
+    // Execute the operations left in the queues, checking them for violations as well.
+    drain(pointers, count);
+
+    measured.violations = HD44780_Sim_counters()->violations;
+
+    printf("%-11s %-23s %7u %7u %7u %7u %7u %7u %7u %7u %7u %7u %10.1f %5u\n", config->name, workload->name,
+           counters->en_pulses, counters->gpio_writes, counters->gpio_reads, counters->gpio_inits,
+           counters->direction_switches, counters->busy_polls, counters->instructions, counters->data_writes,
+           counters->data_reads, counters->i2c_bytes, counters->time_ns / 1000.0, counters->violations);
+
+    bool ok = !counters->violations;
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s / %s: timing violation: %s\n", config->name, workload->name,
+                HD44780_Sim_last_violation());
+    }
+
+    // The counters kept by the library must match the ones observed by the model. Broadcasts pulse several EN lines
+    // with one write, the DMA waveforms are not counted by the library and the initialization resets its counters.
+    if (!workload->bus && workload->run != run_dma_redraw && workload->run != run_reinit_redraw &&
+        workload->run != run_stepped_init && !stats_match(&instances[0].stats, HD44780_Sim_counters()))
+    {
+        fprintf(stderr, "%s / %s: library statistics differ from the model counters\n", config->name, workload->name);
+        ok = false;
+    }
+
+    if (!cgram_match(workload))
+    {
+        fprintf(stderr, "%s / %s: CGRAM content differs from the created symbols\n", config->name, workload->name);
+        ok = false;
+    }
+
+    size_t expected_rows = workload->expected ? strlen(workload->expected) / COLUMNS : 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t r = 0; r < expected_rows; ++r)
+        {
+            char row[COLUMNS + 1];
+            const char *expected = &workload->expected[r * COLUMNS];
+            HD44780_Sim_read_row(sims[i], r, row);
+
+            for (size_t c = 0; c < COLUMNS; ++c)
+            {
+                row[c] |= (uint8_t)row[c] < 0x08 ? 0x08 : 0;
+            }
+
+            if (strncmp(row, expected, COLUMNS))
+            {
+                fprintf(stderr, "%s / %s: expected \"%.*s\" on row %zu, displayed \"%s\"\n", config->name,
+                        workload->name, COLUMNS, expected, r, row);
+                ok = false;
+            }
+        }
+    }
+
+    return ok;
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    printf("%-11s %-23s %7s %7s %7s %7s %7s %7s %7s %7s %7s %7s %10s %5s\n", "config", "workload", "en", "gpio_wr",
+           "gpio_rd", "gpio_in", "dir_sw", "bf_poll", "instr", "data", "data_rd", "i2c", "time_us", "viol");
+
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); ++c)
+    {
+        for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w)
+        {
+            if (supported(&configs[c], &workloads[w]))
+            {
+                ok &= run_workload(&configs[c], &workloads[w]);
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
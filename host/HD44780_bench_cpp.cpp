@@ -0,0 +1,31 @@
+/**
+ * @file HD44780_bench_cpp.cpp Specializations of the C++ front end for the benchmark pin map, used by the "-cpp"
+ * configurations of HD44780_bench.c to measure the compile time specialized register writes.
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#include "HD44780.hpp"
+
+HD44780_PORT(BenchPort, GPIOB);
+
+/** [Hz] Core clock of the benchmark, the delays of the host build are performed by the simulator anyway. */
+constexpr uint32_t BenchClock = 72000000;
+
+template <uint16_t Mask> using PB = hd44780::Pin<BenchPort, Mask>;
+
+using Bench4Bit = hd44780::Display<16, 2, BenchClock, PB<GPIO_PIN_0>, PB<GPIO_PIN_1>, PB<GPIO_PIN_2>,
+                                   PB<GPIO_PIN_12>, PB<GPIO_PIN_13>, PB<GPIO_PIN_14>, PB<GPIO_PIN_15>>;
+
+using Bench8Bit = hd44780::Display<16, 2, BenchClock, PB<GPIO_PIN_0>, PB<GPIO_PIN_1>, PB<GPIO_PIN_2>,
+                                   PB<GPIO_PIN_8>, PB<GPIO_PIN_9>, PB<GPIO_PIN_10>, PB<GPIO_PIN_11>, PB<GPIO_PIN_12>,
+                                   PB<GPIO_PIN_13>, PB<GPIO_PIN_14>, PB<GPIO_PIN_15>>;
+
+// Compile all the members of the front end.
+template class hd44780::Display<16, 2, BenchClock, PB<GPIO_PIN_0>, PB<GPIO_PIN_1>, PB<GPIO_PIN_2>, PB<GPIO_PIN_12>,
+                                PB<GPIO_PIN_13>, PB<GPIO_PIN_14>, PB<GPIO_PIN_15>>;
+
+extern "C" void bench_specialize(HD44780 *lcd)
+{
+    lcd->transmit = lcd->interface_8_bit ? Bench8Bit::transmit : Bench4Bit::transmit;
+}
@@ -0,0 +1,1102 @@
+/**
+ * @file HD44780_sim.c Behavioral model of the %HD44780 controller and stand-in implementation of the stm32 HAL GPIO
+ * functions used by the library.
+ *
+ * Timing values refer to https://www.sparkfun.com/datasheets/LCD/HD44780.pdf pages 24-25 (instruction execution
+ * times) and page 52 (bus timing characteristics, VCC = 4.5 to 5.5V).
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#include "HD44780_sim.h"
+
+#include <string.h>
+
+/*
+ * Constants
+ */
+
+/** Reset value of the GPIO port configuration registers, all pins configured as floating inputs. */
+#define GPIO_CR_RESET 0x44444444u
+
+/** Configuration bits of a push-pull output pin at high speed. */
+#define GPIO_CR_OUTPUT_PP 0x3u
+
+/** Configuration bits of a floating input pin. */
+#define GPIO_CR_INPUT_FLOATING 0x4u
+
+/** [ns] Time from power on after which the controller accepts instructions. */
+static const uint64_t POWER_ON_TIME = 40000000;
+
+/** [ns] Execution time of the clear display and return home instructions. */
+static const uint32_t EXEC_TIME_LONG = 1520000;
+
+/** [ns] Execution time of all the other instructions and of data reads and writes. */
+static const uint32_t EXEC_TIME_SHORT = 37000;
+
+/** [ns] Execution time of the first and second function set instructions of the initialization by instruction. */
+static const uint32_t EXEC_TIME_INIT[] = {4100000, 100000};
+
+/** [ns] Time taken to update the address counter after the busy flag is cleared. */
+static const uint32_t ADDRESS_UPDATE_TIME = 4000;
+
+/** [ns] Minimum enable cycle time. */
+static const uint32_t T_CYCLE_E = 500;
+
+/** [ns] Minimum enable pulse width (high level). */
+static const uint32_t T_PW_EH = 230;
+
+/** [ns] Minimum address set-up time (RS, R/W to E). */
+static const uint32_t T_AS = 40;
+
+/** [ns] Minimum data set-up time. */
+static const uint32_t T_DSW = 80;
+
+/** [ns] Maximum data delay time. */
+static const uint32_t T_DDR = 160;
+
+/*
+ * Modeled CPU cost of the HAL functions, in CPU cycles of an stm32f1 running from flash with 2 wait states.
+ */
+
+static const uint32_t CYCLES_HAL_GPIO_WRITEPIN = 10;
+static const uint32_t CYCLES_HAL_GPIO_READPIN = 10;
+static const uint32_t CYCLES_HAL_GPIO_INIT = 200;
+static const uint32_t CYCLES_DELAY_SETUP = 24;
+static const uint32_t CYCLES_REGISTER_WRITE = 2;
+static const uint32_t CYCLES_REGISTER_READ = 3;
+static const uint32_t CYCLES_HAL_I2C_TRANSMIT = 120;
+static const uint32_t CYCLES_HAL_GET_TICK = 10;
+static const uint32_t CYCLES_DELAY_LOOP = 6;
+
+/** Value of the cycle counter when it is enabled, close to the wraparound so that the first delays cross it. */
+static const uint32_t DWT_CYCCNT_START = 0xFFFFF000u;
+
+/** Number of I2C clock cycles taken by a byte and its acknowledge. */
+static const uint32_t I2C_BYTE_CLOCKS = 9;
+
+/** Output bits of the PCF8574 backpack. */
+static const uint16_t PCF8574_RS = 0x01;
+static const uint16_t PCF8574_RW = 0x02;
+static const uint16_t PCF8574_EN = 0x04;
+static const uint16_t PCF8574_BACKLIGHT = 0x08;
+
+/*
+ * Simulated hardware
+ */
+
+typedef struct
+{
+    GPIO_TypeDef *gpio;
+    uint16_t pin;
+} Line;
+
+struct HD44780_Sim
+{
+    Line rs, rw, en, d[8];
+    uint8_t columns;
+    uint8_t rows;
+    uint16_t osc_scale;
+
+    // Bus interface.
+    bool en_level;
+    bool rs_level;
+    bool rw_level;
+    uint8_t data_level;
+    bool driving;
+    uint8_t read_latch;
+    uint8_t read_value;
+    bool nibble_phase;
+    uint8_t nibble_high;
+    uint64_t en_rise_at;
+    uint64_t en_prev_rise_at;
+    uint64_t signals_changed_at;
+    uint64_t data_changed_at;
+
+    // Controller registers.
+    bool interface_8_bit;
+    bool two_lines;
+    uint8_t entry_mode;
+    uint8_t display_control;
+    uint8_t shift;
+    uint8_t ac;
+    uint8_t ac_prev;
+    bool cgram_selected;
+    uint8_t init_stage;
+    uint64_t ready_at;
+    uint64_t busy_until;
+    uint64_t ac_update_at;
+    uint8_t ddram[HD44780_DDRAM_SIZE];
+    uint8_t cgram[64];
+};
+
+GPIO_TypeDef HD44780_Sim_ports[5] = {
+    {.CRL = GPIO_CR_RESET, .CRH = GPIO_CR_RESET}, {.CRL = GPIO_CR_RESET, .CRH = GPIO_CR_RESET},
+    {.CRL = GPIO_CR_RESET, .CRH = GPIO_CR_RESET}, {.CRL = GPIO_CR_RESET, .CRH = GPIO_CR_RESET},
+    {.CRL = GPIO_CR_RESET, .CRH = GPIO_CR_RESET},
+};
+
+uint32_t SystemCoreClock = 72000000;
+
+uint32_t HD44780_Sim_primask = 0;
+
+static HD44780_Sim sims[HD44780_SIM_MAX_CONTROLLERS];
+static uint8_t sim_count = 0;
+
+static uint64_t now = 0;
+static uint64_t counters_reset_at = 0;
+static HD44780_Sim_Counters counters;
+static const char *last_violation = NULL;
+
+CoreDebug_Type HD44780_Sim_core_debug;
+
+/** SysTick as configured by HAL_Init(): processor clock, 1ms period. */
+static SysTick_Type systick;
+
+#if !defined(HD44780_SIM_CORTEX_M0)
+static DWT_Type dwt;
+
+/** Simulated cycle count when the cycle counter was at 0, valid once it has been enabled. */
+static uint32_t dwt_origin;
+static bool dwt_running;
+#endif
+
+/** Last observed direction of the data bus, used to count direction switches. */
+static bool bus_output = false;
+
+/** Outputs of the PCF8574 backpack, modeled as a port with all the pins configured as outputs. */
+static GPIO_TypeDef expander = {.CRL = GPIO_CR_OUTPUT_PP * 0x11111111u, .CRH = GPIO_CR_OUTPUT_PP * 0x11111111u};
+
+/** Address of the attached PCF8574 backpack, 0 when none is attached. */
+static uint16_t expander_address = 0;
+
+/*
+ * Helpers
+ */
+
+static void advance(uint64_t ns)
+{
+    now += ns;
+}
+
+static uint64_t cycles_to_ns(uint32_t cycles)
+{
+    return (uint64_t)cycles * 1000000000 / SystemCoreClock;
+}
+
+static void violation(const char *description)
+{
+    counters.violations++;
+    last_violation = description;
+}
+
+static uint8_t pin_index(uint16_t pin)
+{
+    uint8_t index = 0;
+
+    while (pin > 1)
+    {
+        pin >>= 1;
+        ++index;
+    }
+
+    return index;
+}
+
+static bool pin_is_output(const GPIO_TypeDef *gpio, uint16_t pin)
+{
+    uint8_t index = pin_index(pin);
+    uint32_t cr = index < 8 ? gpio->CRL : gpio->CRH;
+    return (cr >> ((index % 8) * 4)) & 0x3;
+}
+
+/**
+ * Get the level driven by the attached controllers on a pin configured as input.
+ */
+static bool controller_level(const GPIO_TypeDef *gpio, uint16_t pin)
+{
+    bool level = false;
+
+    for (uint8_t i = 0; i < sim_count; ++i)
+    {
+        const HD44780_Sim *sim = &sims[i];
+
+        if (!sim->driving)
+        {
+            continue;
+        }
+
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            if (sim->d[bit].gpio == gpio && sim->d[bit].pin & pin)
+            {
+                level |= (sim->read_value >> bit) & 1;
+            }
+        }
+    }
+
+    return level;
+}
+
+static bool pin_level(const GPIO_TypeDef *gpio, uint16_t pin)
+{
+    if (pin_is_output(gpio, pin))
+    {
+        return gpio->ODR & pin;
+    }
+
+    return controller_level(gpio, pin);
+}
+
+static bool line_level(const Line *line)
+{
+    return line->gpio && pin_level(line->gpio, line->pin);
+}
+
+static uint32_t exec_time(const HD44780_Sim *sim, uint32_t ns)
+{
+    return (uint64_t)ns * sim->osc_scale / 100;
+}
+
+static uint8_t line_length(const HD44780_Sim *sim)
+{
+    return sim->two_lines ? 40 : 80;
+}
+
+static uint8_t ddram_index(const HD44780_Sim *sim, uint8_t address)
+{
+    if (sim->two_lines)
+    {
+        return address >= 0x40 ? 40 + (address - 0x40) % 40 : address % 40;
+    }
+
+    return address % 80;
+}
+
+/*
+ * Controller model
+ */
+
+static void move_address(HD44780_Sim *sim, bool increment)
+{
+    if (sim->cgram_selected)
+    {
+        sim->ac = (sim->ac + (increment ? 1 : -1)) & 0x3F;
+    }
+    else if (sim->two_lines)
+    {
+        if (increment)
+        {
+            sim->ac = sim->ac == 0x27 ? 0x40 : sim->ac == 0x67 ? 0x00 : sim->ac + 1;
+        }
+        else
+        {
+            sim->ac = sim->ac == 0x40 ? 0x27 : sim->ac == 0x00 ? 0x67 : sim->ac - 1;
+        }
+    }
+    else
+    {
+        if (increment)
+        {
+            sim->ac = sim->ac >= 0x4F ? 0x00 : sim->ac + 1;
+        }
+        else
+        {
+            sim->ac = sim->ac == 0x00 ? 0x4F : sim->ac - 1;
+        }
+    }
+}
+
+static void shift_display(HD44780_Sim *sim, bool left)
+{
+    uint8_t length = line_length(sim);
+    sim->shift = (sim->shift + (left ? 1 : length - 1)) % length;
+}
+
+static void execute_instruction(HD44780_Sim *sim, uint8_t byte)
+{
+    uint32_t time = EXEC_TIME_SHORT;
+
+    counters.instructions++;
+
+    if (byte & 0x80)
+    {
+        sim->ac = byte & 0x7F;
+        sim->cgram_selected = false;
+    }
+    else if (byte & 0x40)
+    {
+        sim->ac = byte & 0x3F;
+        sim->cgram_selected = true;
+    }
+    else if (byte & 0x20)
+    {
+        if (sim->init_stage < 2)
+        {
+            time = EXEC_TIME_INIT[sim->init_stage++];
+        }
+
+        sim->interface_8_bit = byte & 0x10;
+        sim->two_lines = byte & 0x08;
+        sim->shift %= line_length(sim);
+        sim->nibble_phase = false;
+    }
+    else if (byte & 0x10)
+    {
+        if (byte & 0x08)
+        {
+            shift_display(sim, !(byte & 0x04));
+        }
+        else
+        {
+            move_address(sim, byte & 0x04);
+        }
+    }
+    else if (byte & 0x08)
+    {
+        sim->display_control = byte & 0x07;
+    }
+    else if (byte & 0x04)
+    {
+        sim->entry_mode = byte & 0x03;
+    }
+    else if (byte & 0x02)
+    {
+        time = EXEC_TIME_LONG;
+        sim->ac = 0;
+        sim->shift = 0;
+        sim->cgram_selected = false;
+    }
+    else if (byte & 0x01)
+    {
+        time = EXEC_TIME_LONG;
+        memset(sim->ddram, ' ', sizeof(sim->ddram));
+        sim->ac = 0;
+        sim->shift = 0;
+        sim->entry_mode |= 0x02;
+        sim->cgram_selected = false;
+    }
+
+    sim->ac_prev = sim->ac;
+    sim->busy_until = now + exec_time(sim, time);
+}
+
+static void execute_data_write(HD44780_Sim *sim, uint8_t byte)
+{
+    counters.data_writes++;
+
+    sim->ac_prev = sim->ac;
+
+    if (sim->cgram_selected)
+    {
+        sim->cgram[sim->ac & 0x3F] = byte;
+    }
+    else
+    {
+        sim->ddram[ddram_index(sim, sim->ac)] = byte;
+
+        if (sim->entry_mode & 0x01)
+        {
+            shift_display(sim, sim->entry_mode & 0x02);
+        }
+    }
+
+    move_address(sim, sim->entry_mode & 0x02);
+
+    sim->busy_until = now + exec_time(sim, EXEC_TIME_SHORT);
+    sim->ac_update_at = sim->busy_until + ADDRESS_UPDATE_TIME;
+}
+
+static void execute_write(HD44780_Sim *sim, bool rs, uint8_t byte)
+{
+    if (now < sim->ready_at)
+    {
+        violation("write before power-on completion");
+        return;
+    }
+
+    if (now < sim->busy_until)
+    {
+        violation("write while busy");
+        return;
+    }
+
+    if (rs)
+    {
+        execute_data_write(sim, byte);
+    }
+    else
+    {
+        execute_instruction(sim, byte);
+    }
+}
+
+static uint8_t prepare_read(HD44780_Sim *sim, bool rs)
+{
+    if (rs)
+    {
+        if (now < sim->busy_until)
+        {
+            violation("read while busy");
+        }
+
+        return sim->cgram_selected ? sim->cgram[sim->ac & 0x3F] : sim->ddram[ddram_index(sim, sim->ac)];
+    }
+
+    bool busy = now < sim->busy_until || now < sim->ready_at;
+    uint8_t ac = now < sim->ac_update_at ? sim->ac_prev : sim->ac;
+    return busy << 7 | ac;
+}
+
+static void complete_read(HD44780_Sim *sim, bool rs)
+{
+    if (!rs)
+    {
+        counters.busy_polls++;
+        return;
+    }
+
+    counters.data_reads++;
+
+    sim->ac_prev = sim->ac;
+    move_address(sim, sim->entry_mode & 0x02);
+    sim->busy_until = now + exec_time(sim, EXEC_TIME_SHORT);
+    sim->ac_update_at = sim->busy_until + ADDRESS_UPDATE_TIME;
+}
+
+static void enable_rise(HD44780_Sim *sim)
+{
+    counters.en_pulses++;
+
+    if (sim->en_prev_rise_at && now - sim->en_prev_rise_at < T_CYCLE_E)
+    {
+        violation("enable cycle time");
+    }
+
+    if (now - sim->signals_changed_at < T_AS)
+    {
+        violation("address set-up time");
+    }
+
+    sim->en_prev_rise_at = now;
+    sim->en_rise_at = now;
+
+    if (!sim->rw_level)
+    {
+        return;
+    }
+
+    if (sim->interface_8_bit || !sim->nibble_phase)
+    {
+        sim->read_latch = prepare_read(sim, sim->rs_level);
+    }
+
+    // In 4 bit mode the high nibble is transferred first, on DB7 to DB4.
+    if (sim->interface_8_bit)
+    {
+        sim->read_value = sim->read_latch;
+    }
+    else
+    {
+        sim->read_value = sim->nibble_phase ? sim->read_latch << 4 : sim->read_latch & 0xF0;
+    }
+
+    sim->driving = true;
+
+    for (uint8_t bit = 0; bit < 8; ++bit)
+    {
+        if (sim->d[bit].gpio && pin_is_output(sim->d[bit].gpio, sim->d[bit].pin))
+        {
+            violation("bus contention");
+            break;
+        }
+    }
+}
+
+static void enable_fall(HD44780_Sim *sim)
+{
+    if (now - sim->en_rise_at < T_PW_EH)
+    {
+        violation("enable pulse width");
+    }
+
+    if (sim->driving)
+    {
+        sim->driving = false;
+
+        if (sim->interface_8_bit || sim->nibble_phase)
+        {
+            complete_read(sim, sim->rs_level);
+        }
+
+        sim->nibble_phase = !sim->interface_8_bit && !sim->nibble_phase;
+        return;
+    }
+
+    if (now - sim->data_changed_at < T_DSW)
+    {
+        violation("data set-up time");
+    }
+
+    if (sim->interface_8_bit)
+    {
+        execute_write(sim, sim->rs_level, sim->data_level);
+    }
+    else if (!sim->nibble_phase)
+    {
+        sim->nibble_high = sim->data_level & 0xF0;
+        sim->nibble_phase = true;
+    }
+    else
+    {
+        sim->nibble_phase = false;
+        execute_write(sim, sim->rs_level, sim->nibble_high | sim->data_level >> 4);
+    }
+}
+
+/**
+ * Sample the controller lines of all the attached controllers after a GPIO register change.
+ */
+static void bus_update(void)
+{
+    for (uint8_t i = 0; i < sim_count; ++i)
+    {
+        HD44780_Sim *sim = &sims[i];
+
+        bool rs = line_level(&sim->rs);
+        bool rw = line_level(&sim->rw);
+        bool en = line_level(&sim->en);
+        uint8_t data = 0;
+
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            data |= line_level(&sim->d[bit]) << bit;
+        }
+
+        if (rs != sim->rs_level || rw != sim->rw_level)
+        {
+            sim->rs_level = rs;
+            sim->rw_level = rw;
+            sim->signals_changed_at = now;
+        }
+
+        if (!sim->driving && data != sim->data_level)
+        {
+            sim->data_level = data;
+            sim->data_changed_at = now;
+        }
+
+        if (en != sim->en_level)
+        {
+            sim->en_level = en;
+
+            if (en)
+            {
+                enable_rise(sim);
+            }
+            else
+            {
+                enable_fall(sim);
+            }
+        }
+    }
+
+    if (sim_count && sims[0].d[7].gpio)
+    {
+        bool output = pin_is_output(sims[0].d[7].gpio, sims[0].d[7].pin);
+
+        if (output != bus_output)
+        {
+            bus_output = output;
+            counters.direction_switches++;
+        }
+    }
+}
+
+/*
+ * Stand-in HAL implementation
+ */
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+    advance(cycles_to_ns(CYCLES_HAL_GPIO_INIT));
+    counters.gpio_inits++;
+
+    uint32_t config = GPIO_Init->Mode == GPIO_MODE_OUTPUT_PP ? GPIO_CR_OUTPUT_PP : GPIO_CR_INPUT_FLOATING;
+
+    for (uint8_t index = 0; index < 16; ++index)
+    {
+        if (!(GPIO_Init->Pin & (1u << index)))
+        {
+            continue;
+        }
+
+        volatile uint32_t *cr = index < 8 ? &GPIOx->CRL : &GPIOx->CRH;
+        uint8_t shift = (index % 8) * 4;
+        *cr = (*cr & ~(0xFu << shift)) | config << shift;
+    }
+
+    bus_update();
+}
+
+/**
+ * Check that the data driven by the controllers is valid when the input data register is sampled.
+ */
+static void check_data_delay(void)
+{
+    for (uint8_t i = 0; i < sim_count; ++i)
+    {
+        if (sims[i].driving && now - sims[i].en_rise_at < T_DDR)
+        {
+            violation("data delay time");
+        }
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    advance(cycles_to_ns(CYCLES_HAL_GPIO_READPIN));
+    counters.gpio_reads++;
+    check_data_delay();
+
+    return pin_level(GPIOx, GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    advance(cycles_to_ns(CYCLES_HAL_GPIO_WRITEPIN));
+    counters.gpio_writes++;
+
+    if (PinState != GPIO_PIN_RESET)
+    {
+        GPIOx->ODR |= GPIO_Pin;
+    }
+    else
+    {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+
+    bus_update();
+}
+
+/**
+ * Store a value to a GPIO register, applying the BSRR and BRR semantics.
+ */
+static void register_store(GPIO_TypeDef *gpio, volatile uint32_t *reg, uint32_t value)
+{
+    counters.gpio_writes++;
+
+    // The bus transfers are slow, they must not delay the interrupts.
+    if (HD44780_Sim_primask)
+    {
+        violation("bus access with the interrupts masked");
+    }
+
+    if (reg == &gpio->BSRR)
+    {
+        // Set bits take priority over reset bits.
+        gpio->ODR = (gpio->ODR & ~(value >> 16)) | (value & 0xFFFF);
+    }
+    else if (reg == &gpio->BRR)
+    {
+        gpio->ODR &= ~(value & 0xFFFF);
+    }
+    else if (reg != &gpio->IDR)
+    {
+        *reg = value;
+    }
+
+    bus_update();
+}
+
+void HD44780_Sim_gpio_write(GPIO_TypeDef *gpio, volatile uint32_t *reg, uint32_t value)
+{
+    advance(cycles_to_ns(CYCLES_REGISTER_WRITE));
+    register_store(gpio, reg, value);
+}
+
+uint32_t HD44780_Sim_gpio_read(GPIO_TypeDef *gpio, volatile uint32_t *reg)
+{
+    advance(cycles_to_ns(CYCLES_REGISTER_READ));
+
+    if (reg != &gpio->IDR)
+    {
+        return *reg;
+    }
+
+    counters.gpio_reads++;
+    check_data_delay();
+
+    uint32_t idr = 0;
+
+    for (uint8_t index = 0; index < 16; ++index)
+    {
+        idr |= pin_level(gpio, 1u << index) << index;
+    }
+
+    return idr;
+}
+
+/**
+ * Transfer the address and data bytes of an I2C write transaction, updating the expander outputs at the acknowledge
+ * of each data byte as the PCF8574 does.
+ */
+static HAL_StatusTypeDef i2c_transfer(I2C_HandleTypeDef *hi2c, uint16_t address, const uint8_t *data, uint16_t size)
+{
+    uint64_t clock_ns = 1000000000 / hi2c->Init.ClockSpeed;
+
+    // Start condition and address byte.
+    advance(clock_ns + I2C_BYTE_CLOCKS * clock_ns);
+    counters.i2c_bytes++;
+
+    if (!expander_address || address != expander_address)
+    {
+        advance(clock_ns);
+        return HAL_ERROR;
+    }
+
+    for (uint16_t i = 0; i < size; ++i)
+    {
+        advance(I2C_BYTE_CLOCKS * clock_ns);
+        counters.i2c_bytes++;
+        expander.ODR = data[i];
+        bus_update();
+    }
+
+    // Stop condition.
+    advance(clock_ns);
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c,
+                                          uint16_t DevAddress,
+                                          uint8_t *pData,
+                                          uint16_t Size,
+                                          uint32_t Timeout)
+{
+    (void)Timeout;
+
+    advance(cycles_to_ns(CYCLES_HAL_I2C_TRANSMIT));
+    return i2c_transfer(hi2c, DevAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c,
+                                              uint16_t DevAddress,
+                                              uint8_t *pData,
+                                              uint16_t Size)
+{
+    advance(cycles_to_ns(CYCLES_HAL_I2C_TRANSMIT));
+    return i2c_transfer(hi2c, DevAddress, pData, Size);
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c)
+{
+    (void)hi2c;
+
+    advance(cycles_to_ns(CYCLES_REGISTER_READ));
+    return HAL_I2C_STATE_READY;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    advance(cycles_to_ns(CYCLES_HAL_GET_TICK));
+    return now / 1000000;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    advance((uint64_t)Delay * 1000000);
+}
+
+uint32_t HD44780_Sim_cycles(void)
+{
+    return now * (SystemCoreClock / 1000000) / 1000;
+}
+
+void HD44780_Sim_delay_ns(uint32_t ns)
+{
+    advance(cycles_to_ns(CYCLES_DELAY_SETUP) + ns);
+}
+
+SysTick_Type *HD44780_Sim_systick(void)
+{
+    // Each access is modeled as one iteration of a delay loop polling the counter.
+    advance(cycles_to_ns(CYCLES_DELAY_LOOP));
+
+    if (systick.CTRL & SysTick_CTRL_ENABLE_Msk)
+    {
+        // The counter counts down from the reload value, then wraps around to it.
+        uint32_t clock = systick.CTRL & SysTick_CTRL_CLKSOURCE_Msk ? SystemCoreClock : SystemCoreClock / 8;
+        uint64_t ticks = now * (clock / 1000000) / 1000;
+        systick.VAL = systick.LOAD - (uint32_t)(ticks % (systick.LOAD + 1));
+    }
+
+    return &systick;
+}
+
+#if !defined(HD44780_SIM_CORTEX_M0)
+
+DWT_Type *HD44780_Sim_dwt(void)
+{
+    advance(cycles_to_ns(CYCLES_DELAY_LOOP));
+
+    if (!(dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) || !(HD44780_Sim_core_debug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk))
+    {
+        return &dwt;
+    }
+
+    if (!dwt_running)
+    {
+        dwt_running = true;
+        dwt_origin = HD44780_Sim_cycles() - DWT_CYCCNT_START;
+    }
+
+    dwt.CYCCNT = HD44780_Sim_cycles() - dwt_origin;
+
+    return &dwt;
+}
+
+#endif
+
+/*
+ * Simulator interface
+ */
+
+HD44780_Sim *HD44780_Sim_attach(const HD44780 *lcd, uint8_t columns, uint8_t rows)
+{
+    if (sim_count >= HD44780_SIM_MAX_CONTROLLERS)
+    {
+        return NULL;
+    }
+
+    HD44780_Sim *sim = &sims[sim_count++];
+    memset(sim, 0, sizeof(*sim));
+
+    sim->rs = (Line){lcd->rs_gpio, lcd->rs_pin};
+    // In write only mode RW is tied to ground.
+    sim->rw = lcd->write_only ? (Line){NULL, 0} : (Line){lcd->rw_gpio, lcd->rw_pin};
+    sim->en = (Line){lcd->en_gpio, lcd->en_pin};
+    sim->d[4] = (Line){lcd->d4_gpio, lcd->d4_pin};
+    sim->d[5] = (Line){lcd->d5_gpio, lcd->d5_pin};
+    sim->d[6] = (Line){lcd->d6_gpio, lcd->d6_pin};
+    sim->d[7] = (Line){lcd->d7_gpio, lcd->d7_pin};
+
+    // In 4 bit mode DB0 to DB3 are left unconnected.
+    if (lcd->interface_8_bit)
+    {
+        sim->d[0] = (Line){lcd->d0_gpio, lcd->d0_pin};
+        sim->d[1] = (Line){lcd->d1_gpio, lcd->d1_pin};
+        sim->d[2] = (Line){lcd->d2_gpio, lcd->d2_pin};
+        sim->d[3] = (Line){lcd->d3_gpio, lcd->d3_pin};
+    }
+
+    sim->columns = columns;
+    sim->rows = rows;
+    sim->osc_scale = 100;
+
+    HD44780_Sim_power_on(sim);
+
+    return sim;
+}
+
+HD44780_Sim *HD44780_Sim_attach_pcf8574(uint16_t address, uint8_t columns, uint8_t rows)
+{
+    if (expander_address)
+    {
+        return NULL;
+    }
+
+    // The wiring of the backpack, expressed as the pins of a write only 4 bit instance.
+    HD44780 wiring = {
+        .rs_gpio = &expander,
+        .rs_pin = PCF8574_RS,
+        .en_gpio = &expander,
+        .en_pin = PCF8574_EN,
+        .d4_gpio = &expander,
+        .d4_pin = 0x10,
+        .d5_gpio = &expander,
+        .d5_pin = 0x20,
+        .d6_gpio = &expander,
+        .d6_pin = 0x40,
+        .d7_gpio = &expander,
+        .d7_pin = 0x80,
+        .write_only = true,
+    };
+
+    HD44780_Sim *sim = HD44780_Sim_attach(&wiring, columns, rows);
+
+    if (sim)
+    {
+        // RW is driven low by the expander, the controller is never read.
+        sim->rw = (Line){&expander, PCF8574_RW};
+        expander_address = address;
+    }
+
+    return sim;
+}
+
+bool HD44780_Sim_backlight(void)
+{
+    return expander.ODR & PCF8574_BACKLIGHT;
+}
+
+void HD44780_Sim_reset(void)
+{
+    for (uint8_t i = 0; i < sizeof(HD44780_Sim_ports) / sizeof(HD44780_Sim_ports[0]); ++i)
+    {
+        memset(&HD44780_Sim_ports[i], 0, sizeof(HD44780_Sim_ports[i]));
+        HD44780_Sim_ports[i].CRL = GPIO_CR_RESET;
+        HD44780_Sim_ports[i].CRH = GPIO_CR_RESET;
+    }
+
+    memset(&expander, 0, sizeof(expander));
+    expander.CRL = GPIO_CR_OUTPUT_PP * 0x11111111u;
+    expander.CRH = GPIO_CR_OUTPUT_PP * 0x11111111u;
+    expander_address = 0;
+
+    sim_count = 0;
+    now = 0;
+
+    memset(&HD44780_Sim_core_debug, 0, sizeof(HD44780_Sim_core_debug));
+    systick = (SysTick_Type){
+        .CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk,
+        .LOAD = SystemCoreClock / 1000 - 1,
+    };
+
+#if !defined(HD44780_SIM_CORTEX_M0)
+    memset(&dwt, 0, sizeof(dwt));
+    dwt_running = false;
+#endif
+    HD44780_Sim_primask = 0;
+    bus_output = false;
+    last_violation = NULL;
+    HD44780_Sim_reset_counters();
+}
+
+void HD44780_Sim_power_on(HD44780_Sim *sim)
+{
+    // The internal reset circuit executes a clear display and sets the controller to 8 bit, single line mode,
+    // while the CGRAM content is undefined.
+    sim->interface_8_bit = true;
+    sim->two_lines = false;
+    sim->entry_mode = 0x02;
+    sim->display_control = 0x00;
+    sim->shift = 0;
+    sim->ac = 0;
+    sim->ac_prev = 0;
+    sim->cgram_selected = false;
+    sim->init_stage = 0;
+    sim->nibble_phase = false;
+    sim->driving = false;
+    sim->ready_at = now + POWER_ON_TIME;
+    sim->busy_until = 0;
+    sim->ac_update_at = 0;
+    sim->en_prev_rise_at = 0;
+
+    memset(sim->ddram, ' ', sizeof(sim->ddram));
+
+    uint32_t seed = 0x2545F491;
+
+    for (uint8_t i = 0; i < sizeof(sim->cgram); ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        sim->cgram[i] = seed >> 27;
+    }
+}
+
+void HD44780_Sim_set_oscillator_scale(HD44780_Sim *sim, uint16_t percent)
+{
+    sim->osc_scale = percent;
+}
+
+const HD44780_Sim_Counters *HD44780_Sim_counters(void)
+{
+    counters.time_ns = now - counters_reset_at;
+    return &counters;
+}
+
+void HD44780_Sim_reset_counters(void)
+{
+    memset(&counters, 0, sizeof(counters));
+    counters_reset_at = now;
+}
+
+void HD44780_Sim_replay(GPIO_TypeDef *gpio, const uint32_t *words, size_t count, uint32_t tick_ns)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        advance(tick_ns);
+        register_store(gpio, &gpio->BSRR, words[i]);
+    }
+}
+
+uint64_t HD44780_Sim_time_ns(void)
+{
+    return now;
+}
+
+const char *HD44780_Sim_last_violation(void)
+{
+    return last_violation;
+}
+
+uint8_t HD44780_Sim_visible_char(const HD44780_Sim *sim, uint8_t column, uint8_t row)
+{
+    if (!sim->two_lines)
+    {
+        return sim->ddram[(row * sim->columns + column + sim->shift) % 80];
+    }
+
+    // Rows past the second one continue the DDRAM lines of the first two rows (e.g. 20x4 modules).
+    uint8_t line = row % 2;
+    uint8_t offset = (row / 2) * sim->columns;
+    return sim->ddram[line * 40 + (offset + column + sim->shift) % 40];
+}
+
+void HD44780_Sim_read_row(const HD44780_Sim *sim, uint8_t row, char *str)
+{
+    for (uint8_t column = 0; column < sim->columns; ++column)
+    {
+        str[column] = HD44780_Sim_visible_char(sim, column, row);
+    }
+
+    str[sim->columns] = '\0';
+}
+
+uint8_t HD44780_Sim_ddram(const HD44780_Sim *sim, uint8_t address)
+{
+    return sim->ddram[ddram_index(sim, address)];
+}
+
+uint8_t HD44780_Sim_cgram(const HD44780_Sim *sim, uint8_t address)
+{
+    return sim->cgram[address & 0x3F];
+}
+
+void HD44780_Sim_poke(HD44780_Sim *sim, bool cgram, uint8_t address, uint8_t value)
+{
+    if (cgram)
+    {
+        sim->cgram[address & 0x3F] = value;
+    }
+    else
+    {
+        sim->ddram[ddram_index(sim, address)] = value;
+    }
+}
+
+uint8_t HD44780_Sim_address_counter(const HD44780_Sim *sim)
+{
+    return sim->ac;
+}
+
+uint8_t HD44780_Sim_display_shift(const HD44780_Sim *sim)
+{
+    return sim->shift;
+}
+
+uint8_t HD44780_Sim_display_control(const HD44780_Sim *sim)
+{
+    return sim->display_control;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file HD44780_sim.h Behavioral model of the %HD44780 controller, driven by the pin edges produced by the library
+ * through the stand-in HAL in stm32f1xx_hal.h.
+ *
+ * The model implements the 4 and 8 bit interface state machine, DDRAM, CGRAM, the address counter, the entry mode
+ * and shift semantics and the busy flag with the execution times from the datasheet. Bus cost counters and timing
+ * violations are recorded so the library performance can be measured without hardware.
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#ifndef __HD44780_SIM_H__
+#define __HD44780_SIM_H__
+
+#include "HD44780.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of controllers that can be attached to the simulated bus. */
+#define HD44780_SIM_MAX_CONTROLLERS 4
+
+/**
+ * Simulated controller instance.
+ */
+typedef struct HD44780_Sim HD44780_Sim;
+
+/**
+ * Bus cost counters, accumulated across all the attached controllers.
+ */
+typedef struct
+{
+    uint64_t time_ns;            /**< Simulated time elapsed, including modeled CPU time and delays. */
+    uint32_t en_pulses;          /**< Number of EN high pulses. */
+    uint32_t gpio_writes;        /**< Number of GPIO output register writes. */
+    uint32_t gpio_reads;         /**< Number of GPIO input register reads. */
+    uint32_t gpio_inits;         /**< Number of HAL_GPIO_Init() calls. */
+    uint32_t direction_switches; /**< Number of times the data lines switched between input and output. */
+    uint32_t busy_polls;         /**< Number of busy flag and address reads. */
+    uint32_t instructions;       /**< Number of instructions executed. */
+    uint32_t data_writes;        /**< Number of bytes written to DDRAM or CGRAM. */
+    uint32_t data_reads;         /**< Number of bytes read from DDRAM or CGRAM. */
+    uint32_t i2c_bytes;          /**< Number of bytes transferred on the I2C bus, including the address bytes. */
+    uint32_t violations;         /**< Number of datasheet timing or protocol violations. */
+} HD44780_Sim_Counters;
+
+/**
+ * Attach a simulated controller to the pins of a library instance, then power it on.
+ *
+ * @param lcd Library instance whose pin configuration is used to connect the controller.
+ *
+ * @param columns Number of visible columns of the simulated display.
+ *
+ * @param rows Number of visible rows of the simulated display.
+ *
+ * @return The simulated controller, or NULL when @ref HD44780_SIM_MAX_CONTROLLERS are already attached.
+ */
+HD44780_Sim *HD44780_Sim_attach(const HD44780 *lcd, uint8_t columns, uint8_t rows);
+
+/**
+ * Attach a simulated controller behind a PCF8574 I2C backpack, wired as P0 = RS, P1 = RW, P2 = EN, P3 = backlight
+ * and P4 to P7 = DB4 to DB7, then power it on. Only one backpack can be attached.
+ *
+ * @param address Expander address shifted left by one, as passed to the HAL I2C functions.
+ *
+ * @return The simulated controller, or NULL when no more controllers or backpacks can be attached.
+ */
+HD44780_Sim *HD44780_Sim_attach_pcf8574(uint16_t address, uint8_t columns, uint8_t rows);
+
+/**
+ * Get whether the backlight output of the PCF8574 backpack is on.
+ */
+bool HD44780_Sim_backlight(void);
+
+/**
+ * Detach all the controllers, reset the GPIO ports, the counters and the simulated time.
+ */
+void HD44780_Sim_reset(void);
+
+/**
+ * Power cycle a controller, resetting it to the power-on state in 8 bit mode with random RAM content.
+ */
+void HD44780_Sim_power_on(HD44780_Sim *sim);
+
+/**
+ * Scale the execution times of a controller, emulating oscillators running slower or faster than the nominal 270kHz.
+ *
+ * @param percent Execution time scale, 100 is nominal, 150 emulates a clone running 50% slow.
+ */
+void HD44780_Sim_set_oscillator_scale(HD44780_Sim *sim, uint16_t percent);
+
+/**
+ * Get the bus cost counters.
+ */
+const HD44780_Sim_Counters *HD44780_Sim_counters(void);
+
+/**
+ * Reset the bus cost counters. The simulated time is not affected.
+ */
+void HD44780_Sim_reset_counters(void);
+
+/**
+ * Store a waveform to the BSRR register of a port, one word every tick_ns nanoseconds, as a timer-paced DMA channel
+ * would. No CPU time is modeled.
+ */
+void HD44780_Sim_replay(GPIO_TypeDef *gpio, const uint32_t *words, size_t count, uint32_t tick_ns);
+
+/**
+ * Get the current simulated time.
+ */
+uint64_t HD44780_Sim_time_ns(void);
+
+/**
+ * Get the description of the last timing or protocol violation, or NULL when none occurred.
+ */
+const char *HD44780_Sim_last_violation(void);
+
+/**
+ * Get the character displayed at the desired visible position, taking the display shift into account.
+ */
+uint8_t HD44780_Sim_visible_char(const HD44780_Sim *sim, uint8_t column, uint8_t row);
+
+/**
+ * Copy the visible content of a row to a null terminated string of at least columns + 1 characters.
+ */
+void HD44780_Sim_read_row(const HD44780_Sim *sim, uint8_t row, char *str);
+
+/**
+ * Get the DDRAM content at the desired address.
+ */
+uint8_t HD44780_Sim_ddram(const HD44780_Sim *sim, uint8_t address);
+
+/**
+ * Get the CGRAM content at the desired address.
+ */
+uint8_t HD44780_Sim_cgram(const HD44780_Sim *sim, uint8_t address);
+
+/**
+ * Overwrite a DDRAM or CGRAM location without any bus access, emulating a glitch corrupting the controller RAM.
+ */
+void HD44780_Sim_poke(HD44780_Sim *sim, bool cgram, uint8_t address, uint8_t value);
+
+/**
+ * Get the value of the address counter.
+ */
+uint8_t HD44780_Sim_address_counter(const HD44780_Sim *sim);
+
+/**
+ * Get the number of positions the display is shifted to the left, in the range from 0 to the DDRAM line length.
+ */
+uint8_t HD44780_Sim_display_shift(const HD44780_Sim *sim);
+
+/**
+ * Get the last value written to the controller with the display control instruction.
+ */
+uint8_t HD44780_Sim_display_control(const HD44780_Sim *sim);
+
+#endif /* __HD44780_SIM_H__ */
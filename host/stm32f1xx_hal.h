@@ -0,0 +1,267 @@
+/**
+ * @file stm32f1xx_hal.h Stand-in for the stm32f1 HAL header, used to build the %HD44780 library on a host machine.
+ * Only the subset of the HAL used by the library is provided. The GPIO functions are implemented by the controller
+ * model in HD44780_sim.c, which observes the pin edges produced by the library.
+ *
+ * @copyright Copyright 2021 Lorenzo Murarotto. This project is released under the MIT license.
+ */
+
+#ifndef __STM32F1XX_HAL_H__
+#define __STM32F1XX_HAL_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Core
+ */
+
+/** Simulated interrupt mask register, 1 when the interrupts are masked. */
+extern uint32_t HD44780_Sim_primask;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return HD44780_Sim_primask;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask)
+{
+    HD44780_Sim_primask = priMask;
+}
+
+static inline void __disable_irq(void)
+{
+    HD44780_Sim_primask = 1;
+}
+
+/*
+ * Core peripherals
+ *
+ * Stand-ins for the CMSIS core peripherals used by the delay functions of HD44780.c, which are only compiled when
+ * HD44780_SIM_CORE_DELAY is defined (HD44780_DELAY_NS is not provided then). Each access to DWT or SysTick goes through
+ * the model, which updates the counters from the simulated time. The core is a Cortex-M3, or a Cortex-M0 without the
+ * DWT cycle counter when HD44780_SIM_CORTEX_M0 is defined.
+ */
+
+typedef struct
+{
+    volatile uint32_t DHCSR;
+    volatile uint32_t DCRSR;
+    volatile uint32_t DCRDR;
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+/** Simulated debug registers, backing storage for the CoreDebug macro. */
+extern CoreDebug_Type HD44780_Sim_core_debug;
+
+#define CoreDebug (&HD44780_Sim_core_debug)
+
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_ENABLE_Msk (1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk (1UL << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk (1UL << 2)
+#define SysTick_LOAD_RELOAD_Msk (0xFFFFFFUL)
+
+/** Get the simulated SysTick registers, with the current value of the counter. */
+SysTick_Type *HD44780_Sim_systick(void);
+
+#define SysTick (HD44780_Sim_systick())
+
+#if defined(HD44780_SIM_CORTEX_M0)
+
+#define __CORTEX_M (0U)
+
+#else
+
+#define __CORTEX_M (3U)
+
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+/** Get the simulated DWT registers, with the current value of the cycle counter. */
+DWT_Type *HD44780_Sim_dwt(void);
+
+#define DWT (HD44780_Sim_dwt())
+
+#endif
+
+/*
+ * GPIO peripheral
+ */
+
+/** General purpose I/O register map, same layout as the stm32f1 GPIO peripheral. */
+typedef struct
+{
+    volatile uint32_t CRL;
+    volatile uint32_t CRH;
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+    volatile uint32_t BRR;
+    volatile uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0u,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_4 ((uint16_t)0x0010)
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+#define GPIO_PIN_8 ((uint16_t)0x0100)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+#define GPIO_PIN_All ((uint16_t)0xFFFF)
+
+#define GPIO_MODE_INPUT 0x00000000u
+#define GPIO_MODE_OUTPUT_PP 0x00000001u
+
+#define GPIO_NOPULL 0x00000000u
+
+#define GPIO_SPEED_FREQ_LOW 0x00000002u
+#define GPIO_SPEED_FREQ_MEDIUM 0x00000001u
+#define GPIO_SPEED_FREQ_HIGH 0x00000003u
+
+/** Simulated GPIO ports, backing storage for the GPIOx macros. */
+extern GPIO_TypeDef HD44780_Sim_ports[5];
+
+#define GPIOA (&HD44780_Sim_ports[0])
+#define GPIOB (&HD44780_Sim_ports[1])
+#define GPIOC (&HD44780_Sim_ports[2])
+#define GPIOD (&HD44780_Sim_ports[3])
+#define GPIOE (&HD44780_Sim_ports[4])
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+/*
+ * I2C peripheral
+ */
+
+#define HAL_I2C_MODULE_ENABLED
+
+typedef enum
+{
+    HAL_OK = 0x00u,
+    HAL_ERROR = 0x01u,
+    HAL_BUSY = 0x02u,
+    HAL_TIMEOUT = 0x03u
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFu
+
+typedef enum
+{
+    HAL_I2C_STATE_RESET = 0x00u,
+    HAL_I2C_STATE_READY = 0x20u,
+    HAL_I2C_STATE_BUSY_TX = 0x21u
+} HAL_I2C_StateTypeDef;
+
+typedef struct
+{
+    uint32_t ClockSpeed;
+} I2C_InitTypeDef;
+
+/** I2C handle, the transfers are implemented by the PCF8574 expander model in HD44780_sim.c. */
+typedef struct
+{
+    I2C_InitTypeDef Init;
+    volatile HAL_I2C_StateTypeDef State;
+} I2C_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c,
+                                          uint16_t DevAddress,
+                                          uint8_t *pData,
+                                          uint16_t Size,
+                                          uint32_t Timeout);
+
+/** The transfer is modeled as completed when the call returns, the simulated time includes it. */
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c,
+                                              uint16_t DevAddress,
+                                              uint8_t *pData,
+                                              uint16_t Size);
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+
+/*
+ * System
+ */
+
+/** Core clock frequency of the modeled device, used to convert CPU cycles into simulated time. */
+extern uint32_t SystemCoreClock;
+
+uint32_t HAL_GetTick(void);
+
+void HAL_Delay(uint32_t Delay);
+
+/*
+ * Library hooks
+ */
+
+void HD44780_Sim_delay_ns(uint32_t ns);
+
+void HD44780_Sim_gpio_write(GPIO_TypeDef *gpio, volatile uint32_t *reg, uint32_t value);
+
+uint32_t HD44780_Sim_gpio_read(GPIO_TypeDef *gpio, volatile uint32_t *reg);
+
+uint32_t HD44780_Sim_cycles(void);
+
+#if !defined(HD44780_SIM_CORE_DELAY)
+/** Advance the simulated time instead of spinning in the library delay loop. */
+#define HD44780_DELAY_NS(ns) HD44780_Sim_delay_ns(ns)
+#endif
+
+/** Route the library register stores through the controller model. */
+#define HD44780_GPIO_WRITE(gpio, reg, value) HD44780_Sim_gpio_write((gpio), &(gpio)->reg, (value))
+
+/** Route the library register loads through the controller model. */
+#define HD44780_GPIO_READ(gpio, reg) HD44780_Sim_gpio_read((gpio), &(gpio)->reg)
+
+/** Count the CPU cycles of the simulated time. */
+#define HD44780_CYCLES() HD44780_Sim_cycles()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F1XX_HAL_H__ */